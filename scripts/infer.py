@@ -3,11 +3,12 @@ import madrona_escape_room
 
 from madrona_escape_room_learn import LearningState
 
-from policy import make_policy, setup_obs
+from policy import make_policy, setup_obs, setup_flat_obs
 
 import numpy as np
 import argparse
 import math
+import struct
 from pathlib import Path
 import warnings
 warnings.filterwarnings("error")
@@ -25,6 +26,15 @@ arg_parser.add_argument('--num-steps', type=int, required=True)
 arg_parser.add_argument('--num-channels', type=int, default=256)
 arg_parser.add_argument('--separate-value', action='store_true')
 arg_parser.add_argument('--fp16', action='store_true')
+arg_parser.add_argument('--flat-obs', action='store_true')
+arg_parser.add_argument('--obs-precision', choices=['fp32', 'fp16', 'bf16'],
+                        default='fp32')
+arg_parser.add_argument('--compact-lidar', action='store_true')
+arg_parser.add_argument('--lidar-samples', type=int, default=30)
+arg_parser.add_argument('--lidar-span', type=float, default=360,
+                        help='Lidar field of view in degrees')
+arg_parser.add_argument('--lidar-max-range', type=float, default=200)
+arg_parser.add_argument('--lidar-caching', action='store_true')
 
 arg_parser.add_argument('--gpu-sim', action='store_true')
 
@@ -36,10 +46,26 @@ sim = madrona_escape_room.SimManager(
     num_worlds = args.num_worlds,
     rand_seed = 5,
     auto_reset = True,
+    flat_observations = args.flat_obs,
+    obs_precision = args.obs_precision,
+    compact_lidar = args.compact_lidar,
+    num_lidar_samples = args.lidar_samples,
+    lidar_span = math.radians(args.lidar_span),
+    lidar_max_range = args.lidar_max_range,
+    lidar_caching = args.lidar_caching,
 )
 
-obs, num_obs_features = setup_obs(sim)
-policy = make_policy(num_obs_features, args.num_channels, args.separate_value)
+# Half precision observations always use the flat layout
+flat_obs = args.flat_obs or args.obs_precision != 'fp32'
+
+if flat_obs:
+    obs, num_obs_features = setup_flat_obs(sim, args.obs_precision)
+else:
+    obs, num_obs_features = setup_obs(sim, args.compact_lidar,
+                                      args.lidar_samples)
+
+policy = make_policy(num_obs_features, args.num_channels, args.separate_value,
+                     flat_obs)
 
 weights = LearningState.load_policy_weights(args.ckpt_path)
 policy.load_state_dict(weights)
@@ -59,8 +85,24 @@ for shape in policy.recurrent_cfg.shapes:
     cur_rnn_states.append(torch.zeros(
         *shape[0:2], actions.shape[0], shape[2], dtype=torch.float32, device=torch.device('cpu')))
 
+# Action trace format, see src/action_trace.hpp
+ACTION_TRACE_MAGIC = 0x54434145
+ACTION_TRACE_VERSION = 2
+ACTION_TRACE_AUTO_RESET = 1
+ACTION_TRACE_HEADER = struct.Struct('<IIIIQIIII24x')
+ACTION_TRACE_NUM_STEPS_OFFSET = 16
+
+def write_action_trace_header(f, num_worlds, num_agents, num_steps, rand_seed,
+                              auto_reset):
+    f.write(ACTION_TRACE_HEADER.pack(
+        ACTION_TRACE_MAGIC, ACTION_TRACE_VERSION, num_worlds, num_agents,
+        num_steps, rand_seed, 0, ACTION_TRACE_HEADER.size,
+        ACTION_TRACE_AUTO_RESET if auto_reset else 0))
+
 if args.action_dump_path:
     action_log = open(args.action_dump_path, 'wb')
+    write_action_trace_header(action_log, args.num_worlds,
+                              actions.shape[0] // args.num_worlds, 0, 5, True)
 else:
     action_log = None
 
@@ -75,10 +117,13 @@ for i in range(args.num_steps):
         actions.numpy().tofile(action_log)
 
     print()
-    print("Self:", obs[0])
-    print("Partners:", obs[1])
-    print("Room Entities:", obs[2])
-    print("Lidar:", obs[3])
+    if flat_obs:
+        print("Flat Observations:", obs[0])
+    else:
+        print("Self:", obs[0])
+        print("Partners:", obs[1])
+        print("Room Entities:", obs[2])
+        print("Lidar:", obs[3])
 
     print("Move Amount Probs")
     print(" ", np.array_str(probs[0][0].cpu().numpy(), precision=2, suppress_small=True))
@@ -102,4 +147,6 @@ for i in range(args.num_steps):
     print("Rewards:\n", rewards)
 
 if action_log:
+    action_log.seek(ACTION_TRACE_NUM_STEPS_OFFSET)
+    action_log.write(struct.pack('<Q', args.num_steps))
     action_log.close()
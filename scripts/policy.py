@@ -13,12 +13,20 @@ from madrona_escape_room_learn.rnn import LSTM
 import math
 import torch
 
-def setup_obs(sim):
+# With compact_lidar, lidar is read from the simulator's uint8 export and
+# dequantized in process_obs. num_lidar_samples must match the simulator's;
+# the unused samples at the end of each agent's lidar are dropped.
+def setup_obs(sim, compact_lidar = False, num_lidar_samples = 30):
     self_obs_tensor = sim.self_observation_tensor().to_torch()
     partner_obs_tensor = sim.partner_observations_tensor().to_torch()
     room_ent_obs_tensor = sim.room_entity_observations_tensor().to_torch()
     door_obs_tensor = sim.door_observation_tensor().to_torch()
-    lidar_tensor = sim.lidar_tensor().to_torch()
+    if compact_lidar:
+        lidar_tensor = sim.compact_lidar_tensor().to_torch()
+    else:
+        lidar_tensor = sim.lidar_tensor().to_torch()
+
+    lidar_tensor = lidar_tensor[:, :, :num_lidar_samples]
     steps_remaining_tensor = sim.steps_remaining_tensor().to_torch()
 
     N, A = self_obs_tensor.shape[0:2]
@@ -37,7 +45,7 @@ def setup_obs(sim):
         partner_obs_tensor.view(batch_size, *partner_obs_tensor.shape[2:]),
         room_ent_obs_tensor.view(batch_size, *room_ent_obs_tensor.shape[2:]),
         door_obs_tensor.view(batch_size, *door_obs_tensor.shape[2:]),
-        lidar_tensor.view(batch_size, *lidar_tensor.shape[2:]),
+        lidar_tensor.flatten(0, 1),
         steps_remaining_tensor.view(batch_size, *steps_remaining_tensor.shape[2:]),
         id_tensor,
     ]
@@ -48,6 +56,36 @@ def setup_obs(sim):
 
     return obs_tensors, num_obs_features
 
+# With the simulator's flat_observations option, all of the features above
+# arrive in one [N * A, F] tensor (layout in FlatObservation, src/types.hpp),
+# already scaled like process_obs does. With obs_precision 'fp16' or 'bf16'
+# the same layout is read from the half precision export instead, which
+# halves the size of the observations kept in the rollout buffers.
+def setup_flat_obs(sim, obs_precision = 'fp32'):
+    if obs_precision == 'fp32':
+        flat_obs_tensor = sim.flat_observation_tensor().to_torch()
+    else:
+        flat_obs_tensor = sim.half_observation_tensor().to_torch()
+
+        # bf16 is exported as the raw int16 bits
+        if obs_precision == 'bf16':
+            flat_obs_tensor = flat_obs_tensor.view(torch.bfloat16)
+
+    return [flat_obs_tensor], flat_obs_tensor.shape[1]
+
+def process_flat_obs(flat_obs):
+    assert(not torch.isnan(flat_obs).any())
+    assert(not torch.isinf(flat_obs).any())
+
+    return flat_obs.float()
+
+# Inverse of the quantization in CompactLidarSample (src/types.hpp). The
+# type id is scaled by EntityType::NumTypes like the float lidar's
+# encodedType.
+def dequantize_lidar(lidar):
+    scale = torch.tensor([1 / 255, 1 / 6], device=lidar.device)
+    return lidar.float() * scale
+
 def process_obs(self_obs, partner_obs, room_ent_obs,
                 door_obs, lidar, steps_remaining, ids):
     assert(not torch.isnan(self_obs).any())
@@ -59,6 +97,9 @@ def process_obs(self_obs, partner_obs, room_ent_obs,
     assert(not torch.isnan(room_ent_obs).any())
     assert(not torch.isinf(room_ent_obs).any())
 
+    if lidar.dtype == torch.uint8:
+        lidar = dequantize_lidar(lidar)
+
     assert(not torch.isnan(lidar).any())
     assert(not torch.isinf(lidar).any())
 
@@ -70,12 +111,15 @@ def process_obs(self_obs, partner_obs, room_ent_obs,
         partner_obs.view(partner_obs.shape[0], -1),
         room_ent_obs.view(room_ent_obs.shape[0], -1),
         door_obs.view(door_obs.shape[0], -1),
-        lidar.view(lidar.shape[0], -1),
+        lidar.reshape(lidar.shape[0], -1),
         steps_remaining.float() / 200,
         ids,
     ], dim=1)
 
-def make_policy(num_obs_features, num_channels, separate_value):
+def make_policy(num_obs_features, num_channels, separate_value,
+                flat_obs = False):
+    obs_processor = process_flat_obs if flat_obs else process_obs
+
     #encoder = RecurrentBackboneEncoder(
     #    net = MLP(
     #        input_dim = num_obs_features,
@@ -99,7 +143,7 @@ def make_policy(num_obs_features, num_channels, separate_value):
 
     if separate_value:
         backbone = BackboneSeparate(
-            process_obs = process_obs,
+            process_obs = obs_processor,
             actor_encoder = encoder,
             critic_encoder = RecurrentBackboneEncoder(
                 net = MLP(
@@ -116,7 +160,7 @@ def make_policy(num_obs_features, num_channels, separate_value):
         )
     else:
         backbone = BackboneShared(
-            process_obs = process_obs,
+            process_obs = obs_processor,
             encoder = encoder,
         )
 
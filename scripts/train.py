@@ -5,7 +5,7 @@ from madrona_escape_room_learn import (
     train, profile, TrainConfig, PPOConfig, SimInterface,
 )
 
-from policy import make_policy, setup_obs
+from policy import make_policy, setup_obs, setup_flat_obs
 
 import argparse
 import math
@@ -90,6 +90,15 @@ arg_parser.add_argument('--clip-value-loss', action='store_true')
 arg_parser.add_argument('--num-channels', type=int, default=256)
 arg_parser.add_argument('--separate-value', action='store_true')
 arg_parser.add_argument('--fp16', action='store_true')
+arg_parser.add_argument('--flat-obs', action='store_true')
+arg_parser.add_argument('--obs-precision', choices=['fp32', 'fp16', 'bf16'],
+                        default='fp32')
+arg_parser.add_argument('--compact-lidar', action='store_true')
+arg_parser.add_argument('--lidar-samples', type=int, default=30)
+arg_parser.add_argument('--lidar-span', type=float, default=360,
+                        help='Lidar field of view in degrees')
+arg_parser.add_argument('--lidar-max-range', type=float, default=200)
+arg_parser.add_argument('--lidar-caching', action='store_true')
 
 arg_parser.add_argument('--gpu-sim', action='store_true')
 arg_parser.add_argument('--profile-report', action='store_true')
@@ -102,8 +111,18 @@ sim = madrona_escape_room.SimManager(
     num_worlds = args.num_worlds,
     rand_seed = 5,
     auto_reset = True,
+    flat_observations = args.flat_obs,
+    obs_precision = args.obs_precision,
+    compact_lidar = args.compact_lidar,
+    num_lidar_samples = args.lidar_samples,
+    lidar_span = math.radians(args.lidar_span),
+    lidar_max_range = args.lidar_max_range,
+    lidar_caching = args.lidar_caching,
 )
 
+# Half precision observations always use the flat layout
+flat_obs = args.flat_obs or args.obs_precision != 'fp32'
+
 ckpt_dir = Path(args.ckpt_dir)
 
 learning_cb = LearningCallback(ckpt_dir, args.profile_report)
@@ -115,8 +134,14 @@ else:
 
 ckpt_dir.mkdir(exist_ok=True, parents=True)
 
-obs, num_obs_features = setup_obs(sim)
-policy = make_policy(num_obs_features, args.num_channels, args.separate_value)
+if flat_obs:
+    obs, num_obs_features = setup_flat_obs(sim, args.obs_precision)
+else:
+    obs, num_obs_features = setup_obs(sim, args.compact_lidar,
+                                      args.lidar_samples)
+
+policy = make_policy(num_obs_features, args.num_channels, args.separate_value,
+                     flat_obs)
 
 actions = sim.action_tensor().to_torch()
 dones = sim.done_tensor().to_torch()
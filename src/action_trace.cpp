@@ -0,0 +1,257 @@
+#include "action_trace.hpp"
+
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#if defined(MADRONA_LINUX) || defined(MADRONA_MACOS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace madEscape {
+
+using namespace madrona;
+
+// Steps are handed to the writer thread in chunks of roughly this size
+static constexpr uint64_t actionTraceChunkBytes = 4 * 1024 * 1024;
+
+ActionTraceWriter::ActionTraceWriter(const char *path,
+                                     uint32_t num_worlds,
+                                     uint32_t num_agents,
+                                     uint32_t rand_seed,
+                                     bool auto_reset)
+    : path_(path),
+      file_(fopen(path, "wb")),
+      numActionsPerStep_((uint64_t)num_worlds * num_agents),
+      numStepsPerChunk_(std::max(actionTraceChunkBytes /
+          (numActionsPerStep_ * sizeof(Action)), (uint64_t)1)),
+      numSteps_(0),
+      curChunk_(),
+      lock_(),
+      cv_(),
+      pendingChunks_(),
+      freeChunks_(),
+      closing_(false),
+      writeFailed_(false),
+      writerThread_()
+{
+    if (file_ == nullptr) {
+        FATAL("Failed to open action trace %s: %s", path, strerror(errno));
+    }
+
+    ActionTraceHeader header {};
+    header.magic = actionTraceMagic;
+    header.version = actionTraceVersion;
+    header.numWorlds = num_worlds;
+    header.numAgents = num_agents;
+    header.numSteps = 0;
+    header.randSeed = rand_seed;
+    header.layout = ActionTraceLayout::Int32x4;
+    header.headerBytes = sizeof(ActionTraceHeader);
+    header.flags = auto_reset ? actionTraceAutoReset : 0;
+
+    if (fwrite(&header, sizeof(ActionTraceHeader), 1, file_) != 1) {
+        FATAL("Failed to write action trace %s: %s", path, strerror(errno));
+    }
+
+    curChunk_.reserve(numStepsPerChunk_ * numActionsPerStep_);
+
+    writerThread_ = std::thread([this]() {
+        writerLoop();
+    });
+}
+
+ActionTraceWriter::~ActionTraceWriter()
+{
+    close();
+}
+
+void ActionTraceWriter::writeStep(Span<const Action> actions)
+{
+    if ((uint64_t)actions.size() != numActionsPerStep_) {
+        FATAL("ActionTraceWriter: expected %llu actions per step, got %lld",
+              (unsigned long long)numActionsPerStep_,
+              (long long)actions.size());
+    }
+
+    curChunk_.insert(curChunk_.end(), actions.data(),
+                     actions.data() + actions.size());
+    numSteps_++;
+
+    if (curChunk_.size() >= numStepsPerChunk_ * numActionsPerStep_) {
+        submitChunk();
+    }
+}
+
+void ActionTraceWriter::submitChunk()
+{
+    std::vector<Action> next_chunk;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (writeFailed_) {
+            FATAL("Failed to write action trace %s", path_.c_str());
+        }
+
+        pendingChunks_.push_back(std::move(curChunk_));
+
+        if (!freeChunks_.empty()) {
+            next_chunk = std::move(freeChunks_.back());
+            freeChunks_.pop_back();
+        }
+    }
+    cv_.notify_one();
+
+    next_chunk.clear();
+    next_chunk.reserve(numStepsPerChunk_ * numActionsPerStep_);
+    curChunk_ = std::move(next_chunk);
+}
+
+void ActionTraceWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> guard(lock_);
+
+    while (true) {
+        cv_.wait(guard, [this]() {
+            return closing_ || !pendingChunks_.empty();
+        });
+
+        if (pendingChunks_.empty()) {
+            break;
+        }
+
+        std::vector<Action> chunk = std::move(pendingChunks_.front());
+        pendingChunks_.pop_front();
+
+        bool failed = writeFailed_;
+
+        guard.unlock();
+        if (!failed) {
+            failed = fwrite(chunk.data(), sizeof(Action), chunk.size(),
+                            file_) != chunk.size();
+        }
+        guard.lock();
+
+        writeFailed_ = failed;
+
+        freeChunks_.push_back(std::move(chunk));
+    }
+}
+
+void ActionTraceWriter::close()
+{
+    if (file_ == nullptr) {
+        return;
+    }
+
+    if (!curChunk_.empty()) {
+        submitChunk();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        closing_ = true;
+    }
+    cv_.notify_one();
+    writerThread_.join();
+
+    // A failed write leaves numSteps at 0, so readers only see the steps
+    // that made it to disk.
+    bool written = !writeFailed_ &&
+        fseek(file_, offsetof(ActionTraceHeader, numSteps), SEEK_SET) == 0 &&
+        fwrite(&numSteps_, sizeof(uint64_t), 1, file_) == 1;
+    written = fclose(file_) == 0 && written;
+    file_ = nullptr;
+
+    if (!written) {
+        FATAL("Failed to write action trace %s", path_.c_str());
+    }
+}
+
+#if defined(MADRONA_LINUX) || defined(MADRONA_MACOS)
+
+ActionTraceReader::ActionTraceReader(const char *path)
+    : path_(path),
+      mapping_(nullptr),
+      numMappedBytes_(0),
+      header_(nullptr),
+      actions_(nullptr),
+      numSteps_(0)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        FATAL("Failed to open action trace %s: %s", path, strerror(errno));
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        FATAL("Failed to stat action trace %s: %s", path, strerror(errno));
+    }
+
+    numMappedBytes_ = (uint64_t)file_stat.st_size;
+    if (numMappedBytes_ < sizeof(ActionTraceHeader)) {
+        FATAL("%s is not an action trace", path);
+    }
+
+    mapping_ = mmap(nullptr, numMappedBytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping_ == MAP_FAILED) {
+        FATAL("Failed to map action trace %s: %s", path, strerror(errno));
+    }
+
+    // Replays read the file front to back
+    madvise(mapping_, numMappedBytes_, MADV_SEQUENTIAL);
+
+    header_ = (const ActionTraceHeader *)mapping_;
+    if (header_->magic != actionTraceMagic) {
+        FATAL("%s is not an action trace", path);
+    }
+
+    if (header_->version != actionTraceVersion) {
+        FATAL("Action trace %s has version %u, expected %u",
+              path, header_->version, actionTraceVersion);
+    }
+
+    if (header_->layout != ActionTraceLayout::Int32x4 ||
+            header_->headerBytes < sizeof(ActionTraceHeader) ||
+            header_->headerBytes > numMappedBytes_) {
+        FATAL("Action trace %s has an unsupported layout", path);
+    }
+
+    actions_ = (const Action *)((const char *)mapping_ + header_->headerBytes);
+
+    uint64_t num_step_bytes = (uint64_t)header_->numWorlds *
+        header_->numAgents * sizeof(Action);
+    uint64_t num_complete_steps = num_step_bytes == 0 ? 0 :
+        (numMappedBytes_ - header_->headerBytes) / num_step_bytes;
+
+    numSteps_ = header_->numSteps;
+    if (numSteps_ == 0 || numSteps_ > num_complete_steps) {
+        numSteps_ = num_complete_steps;
+    }
+}
+
+ActionTraceReader::~ActionTraceReader()
+{
+    munmap(mapping_, numMappedBytes_);
+}
+
+#else
+
+ActionTraceReader::ActionTraceReader(const char *path)
+{
+    FATAL("Memory mapped action traces are not supported on this platform: %s",
+          path);
+}
+
+ActionTraceReader::~ActionTraceReader() {}
+
+#endif
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <madrona/span.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace madEscape {
+
+// On disk format for recorded actions, shared by headless, the viewer and
+// scripts/infer.py. A 64 byte ActionTraceHeader is followed by numSteps
+// steps of numWorlds * numAgents actions, laid out as [step][world][agent].
+inline constexpr uint32_t actionTraceMagic = 0x54434145; // "EACT"
+inline constexpr uint32_t actionTraceVersion = 2;
+
+// ActionTraceHeader::flags
+// The recorded run used Manager::Config::autoReset, replays must match it
+inline constexpr uint32_t actionTraceAutoReset = 1u << 0;
+
+enum class ActionTraceLayout : uint32_t {
+    // 4 int32s per agent in Action field order:
+    // moveAmount, moveAngle, rotate, grab
+    Int32x4 = 0,
+};
+
+struct ActionTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numWorlds;
+    uint32_t numAgents;
+    // Written when the trace is closed. 0 means the writer didn't finish,
+    // readers then use the number of complete steps in the file.
+    uint64_t numSteps;
+    // Manager::Config::randSeed of the recorded run
+    uint32_t randSeed;
+    ActionTraceLayout layout;
+    uint32_t headerBytes;
+    // actionTrace* flags
+    uint32_t flags;
+    uint32_t reserved[6];
+};
+static_assert(sizeof(ActionTraceHeader) == 64);
+
+// Appends steps to a trace file. writeStep only copies the actions into an
+// in memory chunk; full chunks are written to disk by a background thread so
+// recording doesn't stall the simulation loop on file IO.
+class ActionTraceWriter {
+public:
+    ActionTraceWriter(const char *path,
+                      uint32_t num_worlds,
+                      uint32_t num_agents,
+                      uint32_t rand_seed,
+                      bool auto_reset);
+    ~ActionTraceWriter();
+
+    ActionTraceWriter(const ActionTraceWriter &) = delete;
+    ActionTraceWriter & operator=(const ActionTraceWriter &) = delete;
+
+    // actions must hold numWorlds * numAgents entries
+    void writeStep(madrona::Span<const Action> actions);
+
+    // Flushes outstanding steps and finalizes the header. Called by the
+    // destructor if not called explicitly. Write errors, including ones hit
+    // by the background thread, are fatal here or at the next writeStep.
+    void close();
+
+private:
+    void writerLoop();
+    void submitChunk();
+
+    std::string path_;
+    FILE *file_;
+    uint64_t numActionsPerStep_;
+    uint64_t numStepsPerChunk_;
+    uint64_t numSteps_;
+
+    std::vector<Action> curChunk_;
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<std::vector<Action>> pendingChunks_;
+    std::vector<std::vector<Action>> freeChunks_;
+    bool closing_;
+    // Set by the writer thread when an fwrite fails, later chunks are dropped
+    bool writeFailed_;
+    std::thread writerThread_;
+};
+
+// Read only view of a trace file. The file is memory mapped, so steps are
+// paged in on demand as they are replayed rather than loaded up front.
+class ActionTraceReader {
+public:
+    ActionTraceReader(const char *path);
+    ~ActionTraceReader();
+
+    ActionTraceReader(const ActionTraceReader &) = delete;
+    ActionTraceReader & operator=(const ActionTraceReader &) = delete;
+
+    inline const ActionTraceHeader & header() const { return *header_; }
+    inline uint64_t numSteps() const { return numSteps_; }
+
+    inline madrona::Span<const Action> step(uint64_t step_idx) const
+    {
+        uint64_t num_actions_per_step =
+            (uint64_t)header_->numWorlds * header_->numAgents;
+
+        return madrona::Span<const Action>(
+            actions_ + step_idx * num_actions_per_step,
+            (madrona::CountT)num_actions_per_step);
+    }
+
+private:
+    std::string path_;
+    void *mapping_;
+    uint64_t numMappedBytes_;
+    const ActionTraceHeader *header_;
+    const Action *actions_;
+    uint64_t numSteps_;
+};
+
+}
@@ -0,0 +1,262 @@
+#include "asset_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#if defined(MADRONA_LINUX) || defined(MADRONA_MACOS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace madEscape {
+
+using namespace madrona;
+using namespace madrona::phys;
+
+static constexpr uint64_t assetCacheAlignment = 64;
+
+static inline uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + assetCacheAlignment - 1) & ~(assetCacheAlignment - 1);
+}
+
+RigidBodyAssetCache::RigidBodyAssetCache(const char *cache_dir, uint64_t key)
+    : key_(key),
+      path_(),
+      mapping_(nullptr),
+      numMappedBytes_(0)
+{
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rigid_bodies_%016llx.bin",
+             (unsigned long long)key);
+
+    path_ = (std::filesystem::path(cache_dir) / filename).string();
+}
+
+#if defined(MADRONA_LINUX) || defined(MADRONA_MACOS)
+
+RigidBodyAssetCache::~RigidBodyAssetCache()
+{
+    if (mapping_ != nullptr) {
+        munmap(mapping_, numMappedBytes_);
+    }
+}
+
+bool RigidBodyAssetCache::load(RigidBodyAssets *assets,
+                               uint64_t *num_data_bytes)
+{
+    int fd = open(path_.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+            (uint64_t)file_stat.st_size < sizeof(AssetCacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    uint64_t num_file_bytes = (uint64_t)file_stat.st_size;
+
+    // Private writable mapping: relocation only dirties the pages holding
+    // pointers, the rest of the entry is shared with the page cache.
+    void *mapping = mmap(nullptr, num_file_bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    char *base = (char *)mapping;
+    const AssetCacheHeader &header = *(const AssetCacheHeader *)base;
+
+    bool valid = header.magic == assetCacheMagic &&
+        header.version == assetCacheVersion &&
+        header.key == key_ &&
+        header.numAssetsBytes == sizeof(RigidBodyAssets) &&
+        header.dataOffset >= sizeof(AssetCacheHeader) +
+            sizeof(RigidBodyAssets) &&
+        header.dataOffset + header.numDataBytes <= header.relocationsOffset &&
+        header.relocationsOffset +
+            header.numRelocations * sizeof(uint64_t) <= num_file_bytes;
+
+    if (!valid) {
+        munmap(mapping, num_file_bytes);
+        return false;
+    }
+
+    char *data = base + header.dataOffset;
+    const uint64_t *relocations =
+        (const uint64_t *)(base + header.relocationsOffset);
+
+    for (uint64_t i = 0; i < header.numRelocations; i++) {
+        uint64_t offset = relocations[i];
+        if (offset + sizeof(uint64_t) > header.relocationsOffset) {
+            munmap(mapping, num_file_bytes);
+            return false;
+        }
+
+        uint64_t word;
+        memcpy(&word, base + offset, sizeof(uint64_t));
+        word += (uint64_t)(uintptr_t)data;
+        memcpy(base + offset, &word, sizeof(uint64_t));
+    }
+
+    memcpy(assets, base + sizeof(AssetCacheHeader), sizeof(RigidBodyAssets));
+    *num_data_bytes = header.numDataBytes;
+
+    mapping_ = mapping;
+    numMappedBytes_ = num_file_bytes;
+
+    return true;
+}
+
+// Classifies the word at offset in the two runs. Returns 1 for a pointer
+// into the data blob, 0 for plain data and -1 if the runs disagree.
+static int classifyWord(const char *a, const char *b, uint64_t offset,
+                        uintptr_t data_a, uintptr_t data_b,
+                        uint64_t num_data_bytes, bool strict)
+{
+    uint64_t word_a, word_b;
+    memcpy(&word_a, a + offset, sizeof(uint64_t));
+    memcpy(&word_b, b + offset, sizeof(uint64_t));
+
+    // The one past the end pointer of the last array is a valid pointer too
+    bool in_a = word_a >= data_a && word_a <= data_a + num_data_bytes;
+    bool in_b = word_b >= data_b && word_b <= data_b + num_data_bytes;
+
+    if (in_a && in_b && word_a - data_a == word_b - data_b) {
+        return 1;
+    }
+
+    if (in_a || in_b) {
+        return -1;
+    }
+
+    // Padding in the blob isn't necessarily initialized, so differing data
+    // words are only rejected in the RigidBodyAssets struct itself, where
+    // they could be pointers to memory outside the blob.
+    if (strict && word_a != word_b) {
+        return -1;
+    }
+
+    return 0;
+}
+
+bool RigidBodyAssetCache::store(const RigidBodyAssets &assets,
+                                const void *data,
+                                const RigidBodyAssets &check_assets,
+                                const void *check_data,
+                                uint64_t num_data_bytes)
+{
+    static_assert(sizeof(RigidBodyAssets) % sizeof(uint64_t) == 0);
+
+    uint64_t data_offset =
+        alignOffset(sizeof(AssetCacheHeader) + sizeof(RigidBodyAssets));
+    uint64_t relocations_offset = alignOffset(data_offset + num_data_bytes);
+
+    std::vector<char> entry(relocations_offset, 0);
+    memcpy(entry.data() + sizeof(AssetCacheHeader), &assets,
+           sizeof(RigidBodyAssets));
+    memcpy(entry.data() + data_offset, data, num_data_bytes);
+
+    uintptr_t data_a = (uintptr_t)data;
+    uintptr_t data_b = (uintptr_t)check_data;
+
+    std::vector<uint64_t> relocations;
+
+    auto findPointers = [&](const char *a, const char *b, uint64_t num_bytes,
+                            uint64_t file_offset, bool strict) {
+        for (uint64_t offset = 0; offset + sizeof(uint64_t) <= num_bytes;
+             offset += sizeof(uint64_t)) {
+            int word_type = classifyWord(a, b, offset, data_a, data_b,
+                                         num_data_bytes, strict);
+            if (word_type == -1) {
+                return false;
+            }
+
+            if (word_type == 1) {
+                uint64_t word;
+                memcpy(&word, a + offset, sizeof(uint64_t));
+                word -= data_a;
+                memcpy(entry.data() + file_offset + offset, &word,
+                       sizeof(uint64_t));
+
+                relocations.push_back(file_offset + offset);
+            }
+        }
+
+        return true;
+    };
+
+    if (!findPointers((const char *)&assets, (const char *)&check_assets,
+                      sizeof(RigidBodyAssets), sizeof(AssetCacheHeader),
+                      true) ||
+            !findPointers((const char *)data, (const char *)check_data,
+                          num_data_bytes, data_offset, false)) {
+        return false;
+    }
+
+    AssetCacheHeader header {};
+    header.magic = assetCacheMagic;
+    header.version = assetCacheVersion;
+    header.key = key_;
+    header.numAssetsBytes = sizeof(RigidBodyAssets);
+    header.numDataBytes = num_data_bytes;
+    header.numRelocations = relocations.size();
+    header.dataOffset = data_offset;
+    header.relocationsOffset = relocations_offset;
+    memcpy(entry.data(), &header, sizeof(AssetCacheHeader));
+
+    std::error_code err;
+    std::filesystem::create_directories(
+        std::filesystem::path(path_).parent_path(), err);
+
+    // Many processes may populate the cache at once. Each writes a private
+    // file and renames it into place, so readers never see partial entries.
+    std::string tmp_path = path_ + ".tmp." + std::to_string(getpid());
+
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool written =
+        fwrite(entry.data(), 1, entry.size(), file) == entry.size() &&
+        fwrite(relocations.data(), sizeof(uint64_t), relocations.size(),
+               file) == relocations.size();
+    written = fclose(file) == 0 && written;
+
+    if (!written || rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+RigidBodyAssetCache::~RigidBodyAssetCache() {}
+
+bool RigidBodyAssetCache::load(RigidBodyAssets *, uint64_t *)
+{
+    return false;
+}
+
+bool RigidBodyAssetCache::store(const RigidBodyAssets &, const void *,
+                                const RigidBodyAssets &, const void *,
+                                uint64_t)
+{
+    return false;
+}
+
+#endif
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <madrona/physics_assets.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace madEscape {
+
+// On disk cache for the output of RigidBodyAssets::processRigidBodyAssets.
+// An entry holds the RigidBodyAssets struct followed by its data blob, with
+// every pointer into the blob stored as an offset, and is memory mapped and
+// relocated when loaded. Entries are named by a caller provided key that
+// must hash everything the processed assets depend on.
+inline constexpr uint32_t assetCacheMagic = 0x48435341; // "ASCH"
+inline constexpr uint32_t assetCacheVersion = 1;
+
+struct AssetCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    // Guards against reading entries written by a build with a different
+    // RigidBodyAssets layout
+    uint64_t numAssetsBytes;
+    uint64_t numDataBytes;
+    uint64_t numRelocations;
+    // File offsets of the data blob and of the relocation table, which
+    // lists the file offset of every pointer word
+    uint64_t dataOffset;
+    uint64_t relocationsOffset;
+    uint64_t reserved;
+};
+static_assert(sizeof(AssetCacheHeader) == 64);
+
+class RigidBodyAssetCache {
+public:
+    RigidBodyAssetCache(const char *cache_dir, uint64_t key);
+    ~RigidBodyAssetCache();
+
+    RigidBodyAssetCache(const RigidBodyAssetCache &) = delete;
+    RigidBodyAssetCache & operator=(const RigidBodyAssetCache &) = delete;
+
+    // On a hit, points assets at the mapped entry and returns the size of
+    // its data blob in num_data_bytes. The assets stay valid (and writable)
+    // until the cache object is destroyed.
+    bool load(madrona::phys::RigidBodyAssets *assets,
+              uint64_t *num_data_bytes);
+
+    // Writes the entry for this key. Pointers are found by comparing two
+    // independent runs of processRigidBodyAssets on the same input:
+    // (assets, data) and (check_assets, check_data). Words that differ by
+    // exactly the distance between the two blobs are pointers. Returns false
+    // without writing anything if the runs can't be told apart that way.
+    bool store(const madrona::phys::RigidBodyAssets &assets,
+               const void *data,
+               const madrona::phys::RigidBodyAssets &check_assets,
+               const void *check_data,
+               uint64_t num_data_bytes);
+
+    inline const std::string & path() const { return path_; }
+
+private:
+    uint64_t key_;
+    std::string path_;
+    void *mapping_;
+    uint64_t numMappedBytes_;
+};
+
+}
@@ -1,12 +1,132 @@
 #include "mgr.hpp"
+#include "types.hpp"
 
 #include <madrona/macros.hpp>
 #include <madrona/py/bindings.hpp>
 
+#include <nanobind/ndarray.h>
+#include <nanobind/stl/optional.h>
+#include <nanobind/stl/string.h>
+#include <nanobind/stl/vector.h>
+
+#include <optional>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 namespace nb = nanobind;
 
 namespace madEscape {
 
+static bool dtypeMatches(nb::dlpack::dtype dtype,
+                         madrona::py::TensorElementType type)
+{
+    using madrona::py::TensorElementType;
+    using nb::dlpack::dtype_code;
+
+    auto is = [&](dtype_code code, uint8_t bits) {
+        return dtype.code == (uint8_t)code && dtype.bits == bits &&
+            dtype.lanes == 1;
+    };
+
+    switch (type) {
+    case TensorElementType::UInt8: return is(dtype_code::UInt, 8);
+    case TensorElementType::Int32: return is(dtype_code::Int, 32);
+    case TensorElementType::Float16: return is(dtype_code::Float, 16);
+    case TensorElementType::Float32: return is(dtype_code::Float, 32);
+    // The bf16 observations are exported as Int16
+    case TensorElementType::Int16:
+        return is(dtype_code::Int, 16) || is(dtype_code::Bfloat, 16);
+    default: return false;
+    }
+}
+
+// Validates an optional stepN output buffer against the exported tensor it
+// will receive copies of. The buffer must live on the host or, on the CUDA
+// backend, the simulator's GPU, match the tensor's element type and be
+// [K, N, A, ...] or [K, N * A, ...].
+static void * trajectoryBufferPtr(
+    const std::optional<nb::ndarray<nb::c_contig>> &arr,
+    const madrona::py::Tensor &step_tensor,
+    int64_t num_steps,
+    const char *name)
+{
+    if (!arr.has_value()) {
+        return nullptr;
+    }
+
+    auto invalid = [name](const char *what) {
+        return std::invalid_argument(std::string("step_n: ") + name + " " +
+                                     what);
+    };
+
+    bool on_host = arr->device_type() == nb::device::cpu::value;
+    bool on_sim_gpu = step_tensor.isOnGPU() &&
+        arr->device_type() == nb::device::cuda::value &&
+        arr->device_id() == step_tensor.gpuID();
+    if (!on_host && !on_sim_gpu) {
+        throw invalid(step_tensor.isOnGPU() ?
+            "must be on the host or the simulator's GPU" :
+            "must be on the host");
+    }
+
+    if (!dtypeMatches(arr->dtype(), step_tensor.type())) {
+        throw invalid("has the wrong dtype");
+    }
+
+    // Every exported tensor leads with [N, A] except the flat observations,
+    // which are [N * A, F].
+    const int64_t *dims = step_tensor.dims();
+    int64_t num_dims = step_tensor.numDims();
+    int64_t num_rows = dims[0] * dims[1];
+    int64_t num_row_dims = 2;
+    if (num_dims == 2) {
+        num_rows = dims[0];
+        num_row_dims = 1;
+    }
+
+    bool valid_shape = (int64_t)arr->ndim() >= 2 &&
+        (int64_t)arr->shape(0) == num_steps;
+    if (valid_shape && (int64_t)arr->ndim() == num_dims + 1) {
+        for (int64_t i = 0; i < num_dims; i++) {
+            valid_shape = valid_shape &&
+                (int64_t)arr->shape(i + 1) == dims[i];
+        }
+    } else if (valid_shape &&
+               (int64_t)arr->ndim() == num_dims - num_row_dims + 2) {
+        valid_shape = (int64_t)arr->shape(1) == num_rows;
+        for (int64_t i = num_row_dims; i < num_dims; i++) {
+            valid_shape = valid_shape &&
+                (int64_t)arr->shape(i - num_row_dims + 2) == dims[i];
+        }
+    } else {
+        valid_shape = false;
+    }
+
+    if (!valid_shape) {
+        throw invalid("must be [K, N, A, ...] or [K, N * A, ...] with K "
+                      "matching actions");
+    }
+
+    return arr->data();
+}
+
+static ObservationPrecision parseObsPrecision(const std::string &name)
+{
+    if (name == "fp32") {
+        return ObservationPrecision::Float32;
+    } else if (name == "fp16") {
+        return ObservationPrecision::Float16;
+    } else if (name == "bf16") {
+        return ObservationPrecision::BFloat16;
+    }
+
+    throw std::invalid_argument(
+        "obs_precision must be one of 'fp32', 'fp16' or 'bf16', got '" +
+        name + "'");
+}
+
 // This file creates the python bindings used by the learning code.
 // Refer to the nanobind documentation for more details on these functions.
 NB_MODULE(madrona_escape_room, m) {
@@ -21,7 +141,34 @@ NB_MODULE(madrona_escape_room, m) {
                             int64_t num_worlds,
                             int64_t rand_seed,
                             bool auto_reset,
-                            bool enable_batch_renderer) {
+                            bool enable_batch_renderer,
+                            bool double_buffer_exports,
+                            std::optional<std::string> shared_memory_name,
+                            int64_t num_workers,
+                            int64_t numa_node,
+                            std::vector<int32_t> pinned_cpus,
+                            bool enable_profiling,
+                            std::optional<std::string> trace_path,
+                            std::optional<std::string> asset_cache_dir,
+                            bool flat_observations,
+                            const std::string &obs_precision,
+                            bool compact_lidar,
+                            int64_t num_lidar_samples,
+                            float lidar_span,
+                            float lidar_max_range,
+                            bool lidar_caching) {
+            if (num_lidar_samples < 1 ||
+                    num_lidar_samples > consts::numLidarSamples) {
+                throw std::invalid_argument(
+                    "num_lidar_samples must be between 1 and " +
+                    std::to_string(consts::numLidarSamples));
+            }
+
+            if (!(lidar_span > 0.f) || !(lidar_max_range > 0.f)) {
+                throw std::invalid_argument(
+                    "lidar_span and lidar_max_range must be positive");
+            }
+
             new (self) Manager(Manager::Config {
                 .execMode = exec_mode,
                 .gpuID = (int)gpu_id,
@@ -29,15 +176,209 @@ NB_MODULE(madrona_escape_room, m) {
                 .randSeed = (uint32_t)rand_seed,
                 .autoReset = auto_reset,
                 .enableBatchRenderer = enable_batch_renderer,
+                .doubleBufferExports = double_buffer_exports,
+                .sharedMemoryName = shared_memory_name.has_value() ?
+                    shared_memory_name->c_str() : nullptr,
+                .numWorkers = (uint32_t)num_workers,
+                .numaNode = (int32_t)numa_node,
+                .pinnedCPUs = pinned_cpus.data(),
+                .numPinnedCPUs = (uint32_t)pinned_cpus.size(),
+                .enableProfiling = enable_profiling,
+                .tracePath = trace_path.has_value() ?
+                    trace_path->c_str() : nullptr,
+                .assetCacheDir = asset_cache_dir.has_value() ?
+                    asset_cache_dir->c_str() : nullptr,
+                .flatObservations = flat_observations,
+                .obsPrecision = parseObsPrecision(obs_precision),
+                .compactLidar = compact_lidar,
+                .numLidarSamples = (uint32_t)num_lidar_samples,
+                .lidarSpan = lidar_span,
+                .lidarMaxRange = lidar_max_range,
+                .lidarCaching = lidar_caching,
             });
         }, nb::arg("exec_mode"),
            nb::arg("gpu_id"),
            nb::arg("num_worlds"),
            nb::arg("rand_seed"),
            nb::arg("auto_reset"),
-           nb::arg("enable_batch_renderer") = false)
+           nb::arg("enable_batch_renderer") = false,
+           nb::arg("double_buffer_exports") = false,
+           nb::arg("shared_memory_name") = nb::none(),
+           nb::arg("num_workers") = 0,
+           nb::arg("numa_node") = -1,
+           nb::arg("pinned_cpus") = std::vector<int32_t>(),
+           nb::arg("enable_profiling") = false,
+           nb::arg("trace_path") = nb::none(),
+           nb::arg("asset_cache_dir") = nb::none(),
+           nb::arg("flat_observations") = false,
+           nb::arg("obs_precision") = "fp32",
+           nb::arg("compact_lidar") = false,
+           nb::arg("num_lidar_samples") = consts::numLidarSamples,
+           nb::arg("lidar_span") = 2.f * madrona::math::pi,
+           nb::arg("lidar_max_range") = 200.f,
+           nb::arg("lidar_caching") = false)
         .def("step", &Manager::step)
+        .def("step_async", &Manager::stepAsync)
+        .def("wait", &Manager::wait, nb::call_guard<nb::gil_scoped_release>())
+        .def("profile_report", &Manager::profileReport)
+        .def("reset_profile", &Manager::resetProfile)
+        .def("memory_report", &Manager::memoryReport)
+        .def("snapshot", &Manager::snapshot)
+        .def("restore", &Manager::restore, nb::arg("handle"))
+        .def("release_snapshot", &Manager::releaseSnapshot, nb::arg("handle"))
+        .def("clone_world", [](Manager &mgr,
+                               int64_t src_world,
+                               nb::ndarray<int32_t, nb::c_contig,
+                                           nb::device::cpu> dst_mask) {
+            // dst_mask is [N] or [N, 1], like reset_worlds
+            mgr.cloneWorld((int32_t)src_world, madrona::Span<const int32_t>(
+                dst_mask.data(), dst_mask.size()));
+        }, nb::arg("src_world"), nb::arg("dst_mask"))
+        .def("set_actions", [](Manager &mgr,
+                               nb::ndarray<int32_t, nb::device::cpu> actions) {
+            // Accepts either [N, A, 4] or [N * A, 4] int32 host buffers.
+            // Contiguous inputs are uploaded with a single copy.
+            int64_t num_worlds = mgr.actionTensor().dims()[0];
+
+            int64_t world_stride, agent_stride, field_stride;
+            if (actions.ndim() == 3 &&
+                    (int64_t)actions.shape(0) == num_worlds &&
+                    (int64_t)actions.shape(1) == consts::numAgents &&
+                    actions.shape(2) == 4) {
+                world_stride = actions.stride(0);
+                agent_stride = actions.stride(1);
+                field_stride = actions.stride(2);
+            } else if (actions.ndim() == 2 &&
+                    (int64_t)actions.shape(0) ==
+                        num_worlds * consts::numAgents &&
+                    actions.shape(1) == 4) {
+                agent_stride = actions.stride(0);
+                world_stride = agent_stride * consts::numAgents;
+                field_stride = actions.stride(1);
+            } else {
+                throw std::invalid_argument(
+                    "set_actions: expected an [N, A, 4] or [N * A, 4] buffer");
+            }
+
+            const int32_t *data = actions.data();
+            if (field_stride == 1 && agent_stride == 4 &&
+                    world_stride == 4 * consts::numAgents) {
+                mgr.setActions(madrona::Span<const Action>(
+                    (const Action *)data, num_worlds * consts::numAgents));
+            } else {
+                mgr.setActionsStrided(data, world_stride, agent_stride,
+                                      field_stride);
+            }
+        }, nb::arg("actions"))
+        .def("step_n", [](Manager &mgr,
+                          nb::ndarray<int32_t, nb::c_contig,
+                                      nb::device::cpu> actions,
+                          std::optional<nb::ndarray<nb::c_contig>> rewards,
+                          std::optional<nb::ndarray<nb::c_contig>> dones,
+                          std::optional<nb::ndarray<nb::c_contig>> self_obs,
+                          std::optional<nb::ndarray<nb::c_contig>> partner_obs,
+                          std::optional<nb::ndarray<nb::c_contig>> room_ent_obs,
+                          std::optional<nb::ndarray<nb::c_contig>> door_obs,
+                          std::optional<nb::ndarray<nb::c_contig>> lidar,
+                          std::optional<nb::ndarray<nb::c_contig>> steps_remaining,
+                          std::optional<nb::ndarray<nb::c_contig>> flat_obs,
+                          std::optional<nb::ndarray<nb::c_contig>> half_obs,
+                          std::optional<nb::ndarray<nb::c_contig>> compact_lidar) {
+            // actions: [K, N, A, 4] or [K, N * A, 4] int32 host buffer
+            int64_t num_worlds = mgr.actionTensor().dims()[0];
+
+            bool valid_shape;
+            if (actions.ndim() == 4) {
+                valid_shape = (int64_t)actions.shape(1) == num_worlds &&
+                    (int64_t)actions.shape(2) == consts::numAgents &&
+                    actions.shape(3) == 4;
+            } else if (actions.ndim() == 3) {
+                valid_shape = (int64_t)actions.shape(1) ==
+                        num_worlds * consts::numAgents &&
+                    actions.shape(2) == 4;
+            } else {
+                valid_shape = false;
+            }
+
+            if (!valid_shape) {
+                throw std::invalid_argument(
+                    "step_n: actions must be [K, N, A, 4] or [K, N * A, 4]");
+            }
+
+            int64_t num_steps = actions.shape(0);
+            int64_t num_actions = actions.size() / 4;
+
+            Manager::TrajectoryBuffers out {
+                .rewards = trajectoryBufferPtr(rewards,
+                    mgr.rewardTensor(), num_steps, "rewards"),
+                .dones = trajectoryBufferPtr(dones,
+                    mgr.doneTensor(), num_steps, "dones"),
+                .selfObservations = trajectoryBufferPtr(self_obs,
+                    mgr.selfObservationTensor(), num_steps, "self_obs"),
+                .partnerObservations = trajectoryBufferPtr(partner_obs,
+                    mgr.partnerObservationsTensor(), num_steps,
+                    "partner_obs"),
+                .roomEntityObservations = trajectoryBufferPtr(room_ent_obs,
+                    mgr.roomEntityObservationsTensor(), num_steps,
+                    "room_ent_obs"),
+                .doorObservations = trajectoryBufferPtr(door_obs,
+                    mgr.doorObservationTensor(), num_steps, "door_obs"),
+                .lidars = trajectoryBufferPtr(lidar,
+                    mgr.lidarTensor(), num_steps, "lidar"),
+                .stepsRemaining = trajectoryBufferPtr(steps_remaining,
+                    mgr.stepsRemainingTensor(), num_steps,
+                    "steps_remaining"),
+                .flatObservations = trajectoryBufferPtr(flat_obs,
+                    mgr.flatObservationTensor(), num_steps, "flat_obs"),
+                .halfObservations = trajectoryBufferPtr(half_obs,
+                    mgr.halfObservationTensor(), num_steps, "half_obs"),
+                .compactLidars = trajectoryBufferPtr(compact_lidar,
+                    mgr.compactLidarTensor(), num_steps, "compact_lidar"),
+            };
+
+            nb::gil_scoped_release no_gil;
+            mgr.stepN((int32_t)num_steps, madrona::Span<const Action>(
+                (const Action *)actions.data(), num_actions), out);
+        }, nb::arg("actions"),
+           nb::arg("rewards") = nb::none(),
+           nb::arg("dones") = nb::none(),
+           nb::arg("self_obs") = nb::none(),
+           nb::arg("partner_obs") = nb::none(),
+           nb::arg("room_ent_obs") = nb::none(),
+           nb::arg("door_obs") = nb::none(),
+           nb::arg("lidar") = nb::none(),
+           nb::arg("steps_remaining") = nb::none(),
+           nb::arg("flat_obs") = nb::none(),
+           nb::arg("half_obs") = nb::none(),
+           nb::arg("compact_lidar") = nb::none())
         .def("reset_tensor", &Manager::resetTensor)
+        .def("reset_worlds", [](Manager &mgr,
+                                nb::ndarray<int32_t, nb::c_contig,
+                                            nb::device::cpu> mask) {
+            // Accepts [N] or [N, 1], matching reset_tensor()
+            mgr.resetWorlds(madrona::Span<const int32_t>(
+                mask.data(), mask.size()));
+        }, nb::arg("mask"))
+        .def("reset_all", &Manager::resetAll)
+        .def("world_state_hashes", [](const Manager &mgr,
+                                      nb::ndarray<uint64_t, nb::c_contig,
+                                                  nb::device::cpu> out) {
+            // Fills a caller provided [N] uint64 array
+            mgr.worldStateHashes(madrona::Span<uint64_t>(
+                out.data(), out.size()));
+        }, nb::arg("out"))
+        .def("active_tensor", &Manager::activeTensor)
+        .def("set_world_active", [](Manager &mgr,
+                                    int64_t world_idx,
+                                    bool active) {
+            int64_t num_worlds = mgr.activeTensor().dims()[0];
+            if (world_idx < 0 || world_idx >= num_worlds) {
+                throw std::invalid_argument(
+                    "set_world_active: world_idx out of range");
+            }
+
+            mgr.setWorldActive((int32_t)world_idx, active);
+        }, nb::arg("world_idx"), nb::arg("active"))
         .def("action_tensor", &Manager::actionTensor)
         .def("reward_tensor", &Manager::rewardTensor)
         .def("done_tensor", &Manager::doneTensor)
@@ -48,7 +389,10 @@ NB_MODULE(madrona_escape_room, m) {
         .def("door_observation_tensor",
              &Manager::doorObservationTensor)
         .def("lidar_tensor", &Manager::lidarTensor)
+        .def("compact_lidar_tensor", &Manager::compactLidarTensor)
         .def("steps_remaining_tensor", &Manager::stepsRemainingTensor)
+        .def("flat_observation_tensor", &Manager::flatObservationTensor)
+        .def("half_observation_tensor", &Manager::halfObservationTensor)
         .def("rgb_tensor", &Manager::rgbTensor)
         .def("depth_tensor", &Manager::depthTensor)
     ;
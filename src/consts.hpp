@@ -16,6 +16,13 @@ inline constexpr madrona::CountT numAgents = 2;
 // in order to setup the fixed-size learning tensors appropriately.
 inline constexpr madrona::CountT maxEntitiesPerRoom = 6;
 
+// Currently the physics system needs an upper bound on the number of
+// entities that will be stored in the BVH. We plan to fix this in
+// a future release.
+inline constexpr madrona::CountT maxTotalEntities = numAgents +
+    numRooms * (maxEntitiesPerRoom + 3) +
+    4; // side walls + floor
+
 // Various world / entity size parameters
 inline constexpr float worldLength = 40.f;
 inline constexpr float worldWidth = 20.f;
@@ -38,9 +45,15 @@ inline constexpr madrona::CountT numMoveAmountBuckets = 4;
 inline constexpr madrona::CountT numMoveAngleBuckets = 8;
 inline constexpr madrona::CountT numTurnBuckets = 5;
 
-// Number of lidar samples, arranged in circle around agent
+// Maximum number of lidar samples, arranged in a fan around the agent.
+// Sim::Config::numLidarSamples picks how many are traced at runtime.
 inline constexpr madrona::CountT numLidarSamples = 30;
 
+// With lidar caching, bodies closer than this to their last recorded pose
+// count as stationary. The rotation tolerance is on 1 - |dot(q, q_last)|.
+inline constexpr float lidarCachePosEpsilon = 1e-3f;
+inline constexpr float lidarCacheRotEpsilon = 1e-6f;
+
 // Time (seconds) per step
 inline constexpr float deltaT = 0.04f;
 
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+
+namespace madEscape {
+
+// Element type of the packed observation export (HalfObservation). Float32
+// disables it.
+enum class ObservationPrecision : uint32_t {
+    Float32,
+    Float16,
+    BFloat16,
+};
+
+// Conversions used by the observation systems to fill HalfObservation.
+// Written without intrinsics so they compile for both backends. Both round
+// to nearest even; values above the fp16 range become infinity.
+inline uint32_t floatBits(float f)
+{
+    union {
+        float f;
+        uint32_t u;
+    } bits;
+    bits.f = f;
+
+    return bits.u;
+}
+
+inline uint16_t floatToBFloat16(float f)
+{
+    uint32_t u = floatBits(f);
+
+    // Keep NaNs quiet rather than letting rounding turn them into infinity
+    if ((u & 0x7fffffffu) > 0x7f800000u) {
+        return uint16_t((u >> 16) | 0x40u);
+    }
+
+    u += 0x7fffu + ((u >> 16) & 1u);
+    return uint16_t(u >> 16);
+}
+
+inline uint16_t floatToHalf(float f)
+{
+    uint32_t u = floatBits(f);
+
+    uint16_t sign = uint16_t((u >> 16) & 0x8000u);
+    uint32_t abs_bits = u & 0x7fffffffu;
+
+    // NaN and infinity
+    if (abs_bits >= 0x7f800000u) {
+        return sign | (abs_bits > 0x7f800000u ? 0x7e00u : 0x7c00u);
+    }
+
+    // Overflows to infinity once rounded (65520 and above)
+    if (abs_bits >= 0x477ff000u) {
+        return sign | 0x7c00u;
+    }
+
+    int32_t exp = int32_t(abs_bits >> 23) - 127 + 15;
+    uint32_t mantissa = abs_bits & 0x7fffffu;
+
+    if (exp <= 0) {
+        // Subnormal half or zero
+        if (exp < -10) {
+            return sign;
+        }
+
+        mantissa |= 0x800000u;
+        uint32_t shift = uint32_t(14 - exp);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rem = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1u);
+
+        if (rem > halfway || (rem == halfway && (half_mantissa & 1u))) {
+            half_mantissa++;
+        }
+
+        return sign | uint16_t(half_mantissa);
+    }
+
+    uint32_t half_bits = (uint32_t(exp) << 10) | (mantissa >> 13);
+    uint32_t rem = mantissa & 0x1fffu;
+
+    // A carry out of the mantissa correctly bumps the exponent
+    if (rem > 0x1000u || (rem == 0x1000u && (half_bits & 1u))) {
+        half_bits++;
+    }
+
+    return sign | uint16_t(half_bits);
+}
+
+}
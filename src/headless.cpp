@@ -1,26 +1,521 @@
 #include "mgr.hpp"
+#include "types.hpp"
+#include "consts.hpp"
+#include "action_trace.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdio>
 #include <chrono>
 #include <string>
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <random>
+#include <vector>
 
+#include <madrona/crash.hpp>
 #include <madrona/heap_array.hpp>
+#include <madrona/macros.hpp>
 
 using namespace madrona;
 
-[[maybe_unused]] static void saveWorldActions(
-    const HeapArray<int32_t> &action_store,
-    int32_t total_num_steps,
-    int32_t world_idx)
+namespace madEscape {
+
+enum class ActionSource {
+    // All agents idle: no movement, no rotation and no grab
+    Constant,
+    // Uniformly random over every action bucket, including grab
+    Random,
+    // Replayed from an action trace (src/action_trace.hpp), as written by
+    // --save-actions and scripts/infer.py
+    Trace,
+};
+
+// Budget for the random actions generated up front. Runs longer than the
+// steps that fit (at least one, at most randomActionSteps) cycle through
+// them.
+inline constexpr uint64_t randomActionBytes = 64 * 1024 * 1024;
+inline constexpr uint64_t randomActionSteps = 1024;
+
+// Actions for every step of a run, materialized before timing starts so the
+// driver adds no work to the measured region. Steps past the end wrap.
+// Traces are memory mapped rather than copied, so they are paged in as
+// the run progresses.
+struct ActionSchedule {
+    HeapArray<Action> storage;
+    std::unique_ptr<ActionTraceReader> trace;
+    const Action *actions;
+    uint64_t numSteps;
+    uint64_t numActionsPerStep;
+
+    inline Span<const Action> step(uint64_t step_idx) const
+    {
+        uint64_t offset = (step_idx % numSteps) * numActionsPerStep;
+        return Span<const Action>(actions + offset,
+                                  (CountT)numActionsPerStep);
+    }
+};
+
+static ActionSchedule makeActionSchedule(ActionSource source,
+                                         const std::string &trace_path,
+                                         uint32_t num_worlds,
+                                         uint64_t num_steps)
+{
+    uint64_t num_actions_per_step = (uint64_t)num_worlds * consts::numAgents;
+
+    switch (source) {
+    case ActionSource::Constant: {
+        HeapArray<Action> actions(num_actions_per_step);
+        for (CountT i = 0; i < actions.size(); i++) {
+            actions[i] = Action {
+                .moveAmount = 0,
+                .moveAngle = 0,
+                .rotate = consts::numTurnBuckets / 2,
+                .grab = 0,
+            };
+        }
+
+        const Action *actions_ptr = actions.data();
+        return ActionSchedule {
+            std::move(actions),
+            nullptr,
+            actions_ptr,
+            1,
+            num_actions_per_step,
+        };
+    } break;
+    case ActionSource::Random: {
+        uint64_t budget_steps =
+            randomActionBytes / (num_actions_per_step * sizeof(Action));
+        uint64_t num_schedule_steps = std::max(std::min({
+            num_steps, randomActionSteps, budget_steps }), (uint64_t)1);
+
+        std::mt19937 rand_gen(5);
+        std::uniform_int_distribution<int32_t> move_amount_rand(
+            0, consts::numMoveAmountBuckets - 1);
+        std::uniform_int_distribution<int32_t> move_angle_rand(
+            0, consts::numMoveAngleBuckets - 1);
+        std::uniform_int_distribution<int32_t> rotate_rand(
+            0, consts::numTurnBuckets - 1);
+        std::uniform_int_distribution<int32_t> grab_rand(0, 1);
+
+        HeapArray<Action> actions(num_schedule_steps * num_actions_per_step);
+        for (CountT i = 0; i < actions.size(); i++) {
+            actions[i] = Action {
+                .moveAmount = move_amount_rand(rand_gen),
+                .moveAngle = move_angle_rand(rand_gen),
+                .rotate = rotate_rand(rand_gen),
+                .grab = grab_rand(rand_gen),
+            };
+        }
+
+        const Action *actions_ptr = actions.data();
+        return ActionSchedule {
+            std::move(actions),
+            nullptr,
+            actions_ptr,
+            num_schedule_steps,
+            num_actions_per_step,
+        };
+    } break;
+    case ActionSource::Trace: {
+        auto trace = std::make_unique<ActionTraceReader>(trace_path.c_str());
+        const ActionTraceHeader &header = trace->header();
+
+        if (header.numWorlds != num_worlds ||
+                header.numAgents != consts::numAgents) {
+            FATAL("Action trace %s was recorded with %u worlds and %u agents",
+                  trace_path.c_str(), header.numWorlds, header.numAgents);
+        }
+
+        if (trace->numSteps() == 0) {
+            FATAL("Action trace %s is empty", trace_path.c_str());
+        }
+
+        const Action *actions_ptr = trace->step(0).data();
+        uint64_t num_trace_steps = trace->numSteps();
+        return ActionSchedule {
+            HeapArray<Action>(0),
+            std::move(trace),
+            actions_ptr,
+            num_trace_steps,
+            num_actions_per_step,
+        };
+    } break;
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+// Writes num_steps steps of the schedule as an action trace that can be
+// replayed with --replay or by the viewer.
+static void saveActionSchedule(const ActionSchedule &schedule,
+                               uint32_t num_worlds,
+                               uint32_t rand_seed,
+                               bool auto_reset,
+                               uint64_t num_steps,
+                               const std::string &path)
+{
+    ActionTraceWriter writer(path.c_str(), num_worlds, consts::numAgents,
+                             rand_seed, auto_reset);
+    for (uint64_t i = 0; i < num_steps; i++) {
+        writer.writeStep(schedule.step(i));
+    }
+}
+
+// Per-step state checksums written by --record-hashes and checked by
+// --verify-hashes: a StateHashHeader followed by [step][world] uint64_t
+// hashes from Manager::worldStateHashes. Step 0 is the state after
+// construction, step i the state after the i'th step.
+inline constexpr uint32_t stateHashMagic = 0x48534845; // "EHSH"
+inline constexpr uint32_t stateHashVersion = 1;
+
+struct StateHashHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numWorlds;
+    uint32_t pad;
+    uint64_t numSteps;
+};
+
+// Records or verifies the state hashes of a run, one step at a time
+class StateHashChecker {
+public:
+    StateHashChecker(const std::string &record_path,
+                     const std::string &verify_path,
+                     uint32_t num_worlds)
+        : numWorlds_(num_worlds),
+          numSteps_(0),
+          numReferenceSteps_(0),
+          hashes_(num_worlds),
+          referenceHashes_(num_worlds),
+          record_(),
+          reference_()
+    {
+        if (!record_path.empty()) {
+            record_.open(record_path, std::ios::binary);
+            if (!record_.is_open()) {
+                FATAL("Failed to open %s", record_path.c_str());
+            }
+
+            StateHashHeader header {
+                .magic = stateHashMagic,
+                .version = stateHashVersion,
+                .numWorlds = num_worlds,
+                .pad = 0,
+                .numSteps = 0,
+            };
+            record_.write((const char *)&header, sizeof(StateHashHeader));
+        }
+
+        if (!verify_path.empty()) {
+            reference_.open(verify_path, std::ios::binary);
+
+            StateHashHeader header;
+            reference_.read((char *)&header, sizeof(StateHashHeader));
+            if (!reference_ || header.magic != stateHashMagic ||
+                    header.version != stateHashVersion) {
+                FATAL("%s is not a state hash file", verify_path.c_str());
+            }
+
+            if (header.numWorlds != num_worlds) {
+                FATAL("%s was recorded with %u worlds",
+                      verify_path.c_str(), header.numWorlds);
+            }
+
+            numReferenceSteps_ = header.numSteps;
+        }
+    }
+
+    ~StateHashChecker()
+    {
+        if (record_.is_open()) {
+            record_.seekp(offsetof(StateHashHeader, numSteps));
+            record_.write((const char *)&numSteps_, sizeof(uint64_t));
+        }
+    }
+
+    inline bool enabled() const
+    {
+        return record_.is_open() || reference_.is_open();
+    }
+
+    // Returns false and reports the first divergent world if the current
+    // state doesn't match the reference run.
+    bool check(const Manager &mgr)
+    {
+        mgr.worldStateHashes(Span<uint64_t>(hashes_.data(), numWorlds_));
+
+        uint64_t step_idx = numSteps_++;
+
+        if (record_.is_open()) {
+            record_.write((const char *)hashes_.data(),
+                          sizeof(uint64_t) * numWorlds_);
+        }
+
+        if (!reference_.is_open() || step_idx >= numReferenceSteps_) {
+            return true;
+        }
+
+        reference_.read((char *)referenceHashes_.data(),
+                        sizeof(uint64_t) * numWorlds_);
+
+        CountT num_divergent = 0;
+        CountT first_divergent = -1;
+        for (CountT i = 0; i < (CountT)numWorlds_; i++) {
+            if (hashes_[i] != referenceHashes_[i]) {
+                if (first_divergent == -1) {
+                    first_divergent = i;
+                }
+                num_divergent++;
+            }
+        }
+
+        if (num_divergent == 0) {
+            return true;
+        }
+
+        fprintf(stderr, "Divergence at step %lu in world %ld "
+                "(expected %016lx, got %016lx), %ld worlds differ\n",
+                (unsigned long)step_idx, (long)first_divergent,
+                (unsigned long)referenceHashes_[first_divergent],
+                (unsigned long)hashes_[first_divergent],
+                (long)num_divergent);
+
+        return false;
+    }
+
+    inline uint64_t numVerifiedSteps() const
+    {
+        return std::min(numSteps_, numReferenceSteps_);
+    }
+
+private:
+    uint32_t numWorlds_;
+    uint64_t numSteps_;
+    uint64_t numReferenceSteps_;
+    HeapArray<uint64_t> hashes_;
+    HeapArray<uint64_t> referenceHashes_;
+    std::ofstream record_;
+    std::ifstream reference_;
+};
+
+struct BenchConfig {
+    ExecMode execMode;
+    uint64_t numSteps;
+    uint64_t numWarmupSteps;
+    ActionSource actionSource;
+    std::string actionTracePath;
+    bool profile;
+    // Chrome trace output, empty to disable
+    std::string tracePath;
+};
+
+// Latency percentiles in milliseconds
+struct LatencyStats {
+    uint64_t count;
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+struct BenchResult {
+    uint32_t numWorlds;
+    uint32_t numWorkers;
+    double elapsedSeconds;
+    double stepsPerSecond;
+    double worldStepsPerSecond;
+    LatencyStats all;
+    LatencyStats resetSteps;
+    LatencyStats normalSteps;
+};
+
+static LatencyStats computeLatencyStats(std::vector<double> samples)
+{
+    LatencyStats stats {};
+    stats.count = samples.size();
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    // Nearest-rank percentiles
+    auto percentile = [&samples](double p) {
+        size_t rank = (size_t)std::ceil(p * (double)samples.size());
+        return samples[std::clamp(rank, (size_t)1, samples.size()) - 1];
+    };
+
+    double sum = 0.0;
+    for (double s : samples) {
+        sum += s;
+    }
+
+    stats.mean = sum / (double)samples.size();
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = samples.back();
+
+    return stats;
+}
+
+static BenchResult runBenchmark(const BenchConfig &cfg,
+                                uint32_t num_worlds,
+                                uint32_t num_workers)
+{
+    // All actions are generated or loaded before anything is timed
+    ActionSchedule schedule = makeActionSchedule(cfg.actionSource,
+        cfg.actionTracePath, num_worlds, cfg.numWarmupSteps + cfg.numSteps);
+
+    // Auto reset is enabled so the timed region contains episode
+    // boundaries. All worlds start in lockstep, so world resets happen
+    // exactly on every consts::episodeLen'th step since construction.
+    // Traces run with the seed and autoReset they were recorded with.
+    uint32_t rand_seed = 5;
+    bool auto_reset = true;
+    if (schedule.trace) {
+        rand_seed = schedule.trace->header().randSeed;
+        auto_reset =
+            (schedule.trace->header().flags & actionTraceAutoReset) != 0;
+    }
+
+    Manager mgr({
+        .execMode = cfg.execMode,
+        .gpuID = 0,
+        .numWorlds = num_worlds,
+        .randSeed = rand_seed,
+        .autoReset = auto_reset,
+        .enableBatchRenderer = false,
+        .numWorkers = num_workers,
+        .enableProfiling = cfg.profile,
+        .tracePath = cfg.tracePath.empty() ? nullptr : cfg.tracePath.c_str(),
+    });
+
+    uint64_t step_idx = 0;
+    for (; step_idx < cfg.numWarmupSteps; step_idx++) {
+        mgr.setActions(schedule.step(step_idx));
+        mgr.step();
+    }
+
+    if (cfg.profile) {
+        mgr.resetProfile();
+    }
+
+    std::vector<double> all_latencies;
+    std::vector<double> reset_latencies;
+    std::vector<double> normal_latencies;
+    all_latencies.reserve(cfg.numSteps);
+
+    double elapsed = 0.0;
+    for (uint64_t i = 0; i < cfg.numSteps; i++, step_idx++) {
+        auto start = std::chrono::steady_clock::now();
+        mgr.setActions(schedule.step(step_idx));
+        mgr.step();
+        auto end = std::chrono::steady_clock::now();
+
+        double step_secs = std::chrono::duration<double>(end - start).count();
+        elapsed += step_secs;
+
+        double step_ms = step_secs * 1000.0;
+        all_latencies.push_back(step_ms);
+        if (auto_reset && (step_idx + 1) % consts::episodeLen == 0) {
+            reset_latencies.push_back(step_ms);
+        } else {
+            normal_latencies.push_back(step_ms);
+        }
+    }
+
+    if (cfg.profile) {
+        fprintf(stderr, "%s", mgr.profileReport().c_str());
+    }
+
+    BenchResult result;
+    result.numWorlds = num_worlds;
+    result.numWorkers = num_workers;
+    result.elapsedSeconds = elapsed;
+    result.stepsPerSecond = (double)cfg.numSteps / elapsed;
+    result.worldStepsPerSecond =
+        (double)cfg.numSteps * (double)num_worlds / elapsed;
+    result.all = computeLatencyStats(std::move(all_latencies));
+    result.resetSteps = computeLatencyStats(std::move(reset_latencies));
+    result.normalSteps = computeLatencyStats(std::move(normal_latencies));
+
+    return result;
+}
+
+static const char * actionSourceName(ActionSource source)
+{
+    switch (source) {
+    case ActionSource::Constant: return "noop";
+    case ActionSource::Random: return "random";
+    case ActionSource::Trace: return "trace";
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+static void writeLatencyJSON(FILE *f, const char *name,
+                             const LatencyStats &stats, bool last)
+{
+    fprintf(f, "      \"%s\": {\"count\": %lu, \"mean_ms\": %.6f, "
+            "\"p50_ms\": %.6f, \"p95_ms\": %.6f, \"p99_ms\": %.6f, "
+            "\"max_ms\": %.6f}%s\n",
+            name, (unsigned long)stats.count, stats.mean, stats.p50,
+            stats.p95, stats.p99, stats.max, last ? "" : ",");
+}
+
+static void writeBenchJSON(FILE *f, const BenchConfig &cfg,
+                           const std::vector<BenchResult> &results)
 {
-    const int32_t *world_base = action_store.data() + world_idx * total_num_steps * 2 * 3;
+    fprintf(f, "{\n");
+    fprintf(f, "  \"exec_mode\": \"%s\",\n",
+            cfg.execMode == ExecMode::CUDA ? "CUDA" : "CPU");
+    fprintf(f, "  \"num_steps\": %lu,\n", (unsigned long)cfg.numSteps);
+    fprintf(f, "  \"num_warmup_steps\": %lu,\n",
+            (unsigned long)cfg.numWarmupSteps);
+    fprintf(f, "  \"episode_len\": %d,\n", (int)consts::episodeLen);
+    fprintf(f, "  \"action_source\": \"%s\",\n",
+            actionSourceName(cfg.actionSource));
+    fprintf(f, "  \"runs\": [\n");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"num_worlds\": %u,\n", r.numWorlds);
+        fprintf(f, "      \"num_workers\": %u,\n", r.numWorkers);
+        fprintf(f, "      \"elapsed_s\": %.6f,\n", r.elapsedSeconds);
+        fprintf(f, "      \"steps_per_s\": %.3f,\n", r.stepsPerSecond);
+        fprintf(f, "      \"world_steps_per_s\": %.3f,\n",
+                r.worldStepsPerSecond);
+        writeLatencyJSON(f, "latency", r.all, false);
+        writeLatencyJSON(f, "reset_step_latency", r.resetSteps, false);
+        writeLatencyJSON(f, "normal_step_latency", r.normalSteps, true);
+        fprintf(f, "    }%s\n", i + 1 == results.size() ? "" : ",");
+    }
+
+    fprintf(f, "  ]\n}\n");
+}
+
+static std::vector<uint32_t> parseUIntList(const std::string &list)
+{
+    std::vector<uint32_t> values;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+
+        values.push_back((uint32_t)std::stoul(list.substr(pos, end - pos)));
+        pos = end + 1;
+    }
+
+    return values;
+}
 
-    std::ofstream f("/tmp/actions", std::ios::binary);
-    f.write((char *)world_base,
-            sizeof(uint32_t) * total_num_steps * 2 * 3);
 }
 
 int main(int argc, char *argv[])
@@ -28,7 +523,11 @@ int main(int argc, char *argv[])
     using namespace madEscape;
 
     if (argc < 4) {
-        fprintf(stderr, "%s TYPE NUM_WORLDS NUM_STEPS [--rand-actions]\n", argv[0]);
+        fprintf(stderr, "%s TYPE NUM_WORLDS NUM_STEPS [--actions noop|random] "
+                "[--rand-actions] [--replay PATH] [--save-actions PATH] "
+                "[--record-hashes PATH] [--verify-hashes PATH] [--threads N] "
+                "[--bench] [--warmup N] [--sweep-worlds N,N,...] "
+                "[--sweep-threads N,N,...] [--json PATH] [--profile] [--trace PATH]\n", argv[0]);
         return -1;
     }
     std::string type(argv[1]);
@@ -46,52 +545,219 @@ int main(int argc, char *argv[])
     uint64_t num_worlds = std::stoul(argv[2]);
     uint64_t num_steps = std::stoul(argv[3]);
 
-    HeapArray<int32_t> action_store(
-        num_worlds * 2 * num_steps * 3);
+    ActionSource action_source = ActionSource::Constant;
+    std::string action_trace_path;
+    std::string save_actions_path;
+    std::string record_hashes_path;
+    std::string verify_hashes_path;
+    uint32_t num_workers = 0;
+    bool has_num_workers = false;
+    bool bench = false;
+    bool profile = false;
+    std::string trace_path;
+    uint64_t num_warmup_steps = 100;
+    std::vector<uint32_t> sweep_worlds;
+    std::vector<uint32_t> sweep_threads;
+    std::string json_path;
+
+    for (int i = 4; i < argc; i++) {
+        std::string arg(argv[i]);
+        bool has_value = i + 1 < argc;
 
-    bool rand_actions = false;
-    if (argc >= 5) {
-        if (std::string(argv[4]) == "--rand-actions") {
-            rand_actions = true;
+        if (arg == "--rand-actions") {
+            action_source = ActionSource::Random;
+        } else if (arg == "--actions" && has_value) {
+            std::string source_name(argv[++i]);
+            if (source_name == "noop") {
+                action_source = ActionSource::Constant;
+            } else if (source_name == "random") {
+                action_source = ActionSource::Random;
+            } else {
+                fprintf(stderr, "Invalid action source %s\n",
+                        source_name.c_str());
+                return -1;
+            }
+        } else if (arg == "--replay" && has_value) {
+            action_source = ActionSource::Trace;
+            action_trace_path = argv[++i];
+        } else if (arg == "--save-actions" && has_value) {
+            save_actions_path = argv[++i];
+        } else if (arg == "--record-hashes" && has_value) {
+            record_hashes_path = argv[++i];
+        } else if (arg == "--verify-hashes" && has_value) {
+            verify_hashes_path = argv[++i];
+        } else if (arg == "--threads" && has_value) {
+            num_workers = (uint32_t)std::stoul(argv[++i]);
+            has_num_workers = true;
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--warmup" && has_value) {
+            num_warmup_steps = std::stoul(argv[++i]);
+        } else if (arg == "--sweep-worlds" && has_value) {
+            sweep_worlds = parseUIntList(argv[++i]);
+        } else if (arg == "--sweep-threads" && has_value) {
+            sweep_threads = parseUIntList(argv[++i]);
+        } else if (arg == "--trace" && has_value) {
+            trace_path = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else {
+            fprintf(stderr, "Invalid argument %s\n", arg.c_str());
+            return -1;
         }
     }
 
+    if (bench) {
+        if (!save_actions_path.empty() || !record_hashes_path.empty() ||
+                !verify_hashes_path.empty()) {
+            fprintf(stderr, "--save-actions, --record-hashes and "
+                    "--verify-hashes are not supported with --bench\n");
+            return -1;
+        }
+
+        if (has_num_workers && !sweep_threads.empty()) {
+            fprintf(stderr, "--threads and --sweep-threads are exclusive\n");
+            return -1;
+        }
+
+        if (sweep_worlds.empty()) {
+            sweep_worlds.push_back((uint32_t)num_worlds);
+        }
+
+        if (has_num_workers) {
+            sweep_threads = { num_workers };
+        }
+
+        // Thread count only applies to the CPU backend; 0 lets the
+        // executor pick one worker per hardware thread.
+        if (sweep_threads.empty() || exec_mode == ExecMode::CUDA) {
+            sweep_threads = { 0 };
+        }
+
+        if (!trace_path.empty() &&
+                sweep_worlds.size() * sweep_threads.size() > 1) {
+            fprintf(stderr, "--trace only supports a single configuration\n");
+            return -1;
+        }
+
+        BenchConfig bench_cfg {
+            .execMode = exec_mode,
+            .numSteps = num_steps,
+            .numWarmupSteps = num_warmup_steps,
+            .actionSource = action_source,
+            .actionTracePath = action_trace_path,
+            .profile = profile,
+            .tracePath = trace_path,
+        };
+
+        std::vector<BenchResult> results;
+        for (uint32_t bench_worlds : sweep_worlds) {
+            for (uint32_t bench_threads : sweep_threads) {
+                BenchResult result =
+                    runBenchmark(bench_cfg, bench_worlds, bench_threads);
+
+                fprintf(stderr, "worlds %u threads %u: FPS %f, "
+                        "p50 %.3fms p99 %.3fms, "
+                        "reset p50 %.3fms, normal p50 %.3fms\n",
+                        bench_worlds, bench_threads,
+                        result.worldStepsPerSecond,
+                        result.all.p50, result.all.p99,
+                        result.resetSteps.p50, result.normalSteps.p50);
+
+                results.push_back(result);
+            }
+        }
+
+        if (json_path.empty() || json_path == "-") {
+            writeBenchJSON(stdout, bench_cfg, results);
+        } else {
+            FILE *json_file = fopen(json_path.c_str(), "w");
+            if (!json_file) {
+                fprintf(stderr, "Failed to open %s\n", json_path.c_str());
+                return -1;
+            }
+            writeBenchJSON(json_file, bench_cfg, results);
+            fclose(json_file);
+        }
+
+        return 0;
+    }
+
+    ActionSchedule schedule = makeActionSchedule(action_source,
+        action_trace_path, (uint32_t)num_worlds, num_steps);
+
+    // Replays run with the recorded run's seed and autoReset, or they
+    // generate different levels and their episodes (and state hashes)
+    // diverge.
+    uint32_t rand_seed = 5;
+    bool auto_reset = false;
+    if (schedule.trace) {
+        rand_seed = schedule.trace->header().randSeed;
+        auto_reset =
+            (schedule.trace->header().flags & actionTraceAutoReset) != 0;
+    }
+
+    // Wrapped trace steps would be checked as if they had been recorded
+    bool checking_hashes =
+        !record_hashes_path.empty() || !verify_hashes_path.empty();
+    if (checking_hashes && schedule.trace &&
+            num_steps > schedule.numSteps) {
+        FATAL("Action trace %s only has %lu steps, %lu requested",
+              action_trace_path.c_str(), (unsigned long)schedule.numSteps,
+              (unsigned long)num_steps);
+    }
+
+    if (!save_actions_path.empty()) {
+        saveActionSchedule(schedule, (uint32_t)num_worlds, rand_seed,
+                           auto_reset, num_steps, save_actions_path);
+    }
+
     Manager mgr({
         .execMode = exec_mode,
         .gpuID = 0,
         .numWorlds = (uint32_t)num_worlds,
-        .randSeed = 5,
-        .autoReset = false,
+        .randSeed = rand_seed,
+        .autoReset = auto_reset,
         .enableBatchRenderer = false,
+        .numWorkers = num_workers,
     });
 
-    std::random_device rd;
-    std::mt19937 rand_gen(rd());
-    std::uniform_int_distribution<int32_t> act_rand(0, 4);
+    StateHashChecker hash_checker(record_hashes_path, verify_hashes_path,
+                                  (uint32_t)num_worlds);
 
-    auto start = std::chrono::system_clock::now();
+    // Verification runs step by step and aren't timed
+    if (hash_checker.enabled()) {
+        bool matches = hash_checker.check(mgr);
 
-    for (CountT i = 0; i < (CountT)num_steps; i++) {
-        if (rand_actions) {
-            for (CountT j = 0; j < (CountT)num_worlds; j++) {
-                for (CountT k = 0; k < 2; k++) {
-                    int32_t x = act_rand(rand_gen);
-                    int32_t y = act_rand(rand_gen);
-                    int32_t r = act_rand(rand_gen);
-
-                    mgr.setAction(j, k, x, y, r, 0);
-                    
-                    int64_t base_idx = j * num_steps * 2 * 3 + i * 2 * 3 + k * 3;
-                    action_store[base_idx] = x;
-                    action_store[base_idx + 1] = y;
-                    action_store[base_idx + 2] = r;
-                }
-            }
+        for (CountT i = 0; matches && i < (CountT)num_steps; i++) {
+            mgr.setActions(schedule.step(i));
+            mgr.step();
+
+            matches = hash_checker.check(mgr);
+        }
+
+        if (!matches) {
+            return 1;
+        }
+
+        if (!verify_hashes_path.empty()) {
+            printf("Verified %lu steps\n",
+                   (unsigned long)hash_checker.numVerifiedSteps());
         }
+
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (CountT i = 0; i < (CountT)num_steps; i++) {
+        mgr.setActions(schedule.step(i));
         mgr.step();
     }
 
-    auto end = std::chrono::system_clock::now();
+    auto end = std::chrono::steady_clock::now();
     std::chrono::duration<double> elapsed = end - start;
 
     float fps = (double)num_steps * (double)num_worlds / elapsed.count();
@@ -167,6 +167,27 @@ void createPersistentEntities(Engine &ctx)
         ctx.get<ResponseType>(agent) = ResponseType::Dynamic;
         ctx.get<GrabState>(agent).constraintEntity = Entity::none();
         ctx.get<EntityType>(agent) = EntityType::Agent;
+
+        // Only written by the Step task graph, so give the values exported
+        // after the Init task graph a defined state.
+        ctx.get<Reward>(agent).v = 0.f;
+        ctx.get<Done>(agent).v = 0;
+
+        // lidarSystem never writes samples past Sim::numLidarSamples
+        ctx.get<Lidar>(agent) = {};
+        ctx.get<CompactLidar>(agent) = {};
+
+        float agent_id = consts::numAgents > 1 ?
+            float(i) / float(consts::numAgents - 1) : 0.f;
+
+        ctx.get<FlatObservation>(agent) = {};
+        ctx.get<FlatObservation>(agent).features[flatAgentIDOffset] =
+            agent_id;
+
+        ctx.get<HalfObservation>(agent) = {};
+        ctx.get<HalfObservation>(agent).features[flatAgentIDOffset] =
+            ctx.data().obsPrecision == ObservationPrecision::BFloat16 ?
+                floatToBFloat16(agent_id) : floatToHalf(agent_id);
     }
 
     // Populate OtherAgents component, which maintains a reference to the
@@ -1,5 +1,8 @@
 #include "mgr.hpp"
 #include "sim.hpp"
+#include "shared_exports.hpp"
+#include "step_trace.hpp"
+#include "asset_cache.hpp"
 
 #include <madrona/utils.hpp>
 #include <madrona/importer.hpp>
@@ -8,12 +11,27 @@
 #include <madrona/mw_cpu.hpp>
 #include <madrona/render/api.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <charconv>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef MADRONA_LINUX
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #ifdef MADRONA_CUDA_SUPPORT
 #include <madrona/mw_gpu.hpp>
@@ -84,36 +102,277 @@ static inline Optional<render::RenderManager> initRenderManager(
     });
 }
 
+// Number of bytes each exported buffer holds for a single world
+static inline uint64_t exportBytesPerWorld(ExportID slot)
+{
+    switch (slot) {
+    case ExportID::Reset:
+        return sizeof(WorldReset);
+    case ExportID::Active:
+        return sizeof(WorldActive);
+    case ExportID::Action:
+        return sizeof(Action) * consts::numAgents;
+    case ExportID::Reward:
+        return sizeof(Reward) * consts::numAgents;
+    case ExportID::Done:
+        return sizeof(Done) * consts::numAgents;
+    case ExportID::SelfObservation:
+        return sizeof(SelfObservation) * consts::numAgents;
+    case ExportID::PartnerObservations:
+        return sizeof(PartnerObservations) * consts::numAgents;
+    case ExportID::RoomEntityObservations:
+        return sizeof(RoomEntityObservations) * consts::numAgents;
+    case ExportID::DoorObservation:
+        return sizeof(DoorObservation) * consts::numAgents;
+    case ExportID::Lidar:
+        return sizeof(Lidar) * consts::numAgents;
+    case ExportID::StepsRemaining:
+        return sizeof(StepsRemaining) * consts::numAgents;
+    case ExportID::FlatObservation:
+        return sizeof(FlatObservation) * consts::numAgents;
+    case ExportID::HalfObservation:
+        return sizeof(HalfObservation) * consts::numAgents;
+    case ExportID::CompactLidar:
+        return sizeof(CompactLidar) * consts::numAgents;
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+static const char * exportName(ExportID slot)
+{
+    switch (slot) {
+    case ExportID::Reset: return "reset";
+    case ExportID::Active: return "active";
+    case ExportID::Action: return "action";
+    case ExportID::Reward: return "reward";
+    case ExportID::Done: return "done";
+    case ExportID::SelfObservation: return "selfObservation";
+    case ExportID::PartnerObservations: return "partnerObservations";
+    case ExportID::RoomEntityObservations: return "roomEntityObservations";
+    case ExportID::DoorObservation: return "doorObservation";
+    case ExportID::Lidar: return "lidar";
+    case ExportID::StepsRemaining: return "stepsRemaining";
+    case ExportID::FlatObservation: return "flatObservation";
+    case ExportID::HalfObservation: return "halfObservation";
+    case ExportID::CompactLidar: return "compactLidar";
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+static const char * profileNodeName(ProfileNode node)
+{
+    switch (node) {
+    case ProfileNode::Movement: return "movement";
+    case ProfileNode::SetDoorPosition: return "setDoorPosition";
+    case ProfileNode::Broadphase: return "broadphase";
+    case ProfileNode::Grab: return "grab";
+    case ProfileNode::PhysicsStep: return "physicsStep";
+    case ProfileNode::AgentZeroVelocity: return "agentZeroVelocity";
+    case ProfileNode::PhysicsCleanup: return "physicsCleanup";
+    case ProfileNode::Button: return "button";
+    case ProfileNode::DoorOpen: return "doorOpen";
+    case ProfileNode::Reward: return "reward";
+    case ProfileNode::BonusReward: return "bonusReward";
+    case ProfileNode::StepTracker: return "stepTracker";
+    case ProfileNode::Reset: return "reset";
+    case ProfileNode::PostResetBroadphase: return "postResetBroadphase";
+    case ProfileNode::CollectObservations: return "collectObservations";
+    case ProfileNode::Lidar: return "lidar";
+    case ProfileNode::Render: return "render";
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+// Exports that are written by the caller and read by the simulation.
+// All other exports flow out of the simulation.
+static inline bool isInputExport(ExportID slot)
+{
+    return slot == ExportID::Reset || slot == ExportID::Active ||
+        slot == ExportID::Action;
+}
+
+// The optional observation exports are never written unless enabled, so
+// the staged export and stepN copies skip them.
+static inline bool isExportEnabled(const Manager::Config &cfg, ExportID slot)
+{
+    switch (slot) {
+    case ExportID::FlatObservation: return cfg.flatObservations;
+    case ExportID::HalfObservation:
+        return cfg.obsPrecision != ObservationPrecision::Float32;
+    case ExportID::CompactLidar: return cfg.compactLidar;
+    default: return true;
+    }
+}
+
+// Allocates memory the simulation can access directly: device memory on the
+// CUDA backend, host memory otherwise.
+static void * allocSimBuffer(ExecMode exec_mode, uint64_t num_bytes)
+{
+    if (exec_mode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        return cu::allocGPU(num_bytes);
+#else
+        MADRONA_UNREACHABLE();
+#endif
+    }
+
+    return malloc(num_bytes);
+}
+
+static void freeSimBuffer(ExecMode exec_mode, void *ptr)
+{
+    if (exec_mode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        cu::deallocGPU(ptr);
+#endif
+    } else {
+        free(ptr);
+    }
+}
+
+// Memory measured while the Manager was constructed, see memoryReport()
+struct MemoryStats {
+    // Size of the processed collision assets handed to the PhysicsLoader
+    uint64_t assetBytes;
+    // Growth of resident (CPU) or device (CUDA) memory while the executor
+    // was created: ECS tables, physics / BVH state and exported buffers
+    // of all worlds, plus the executor's own fixed overhead.
+    uint64_t executorBytes;
+};
+
+// Resident set size of this process, 0 where it can't be queried
+static uint64_t residentBytes()
+{
+#ifdef MADRONA_LINUX
+    std::ifstream statm("/proc/self/statm");
+    uint64_t num_pages = 0, num_resident_pages = 0;
+    if (!(statm >> num_pages >> num_resident_pages)) {
+        return 0;
+    }
+
+    return num_resident_pages * (uint64_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
 struct Manager::Impl {
     Config cfg;
     PhysicsLoader physicsLoader;
     WorldReset *worldResetBuffer;
+    WorldActive *worldActiveBuffer;
     Action *agentActionsBuffer;
     Optional<RenderGPUState> renderGPUState;
     Optional<render::RenderManager> renderMgr;
+    bool stepInFlight;
+    // Set when the exports live in a shared memory region
+    SharedExportHeader *sharedExportHeader;
+    // Set when Config::tracePath is
+    std::unique_ptr<StepTraceWriter> traceWriter;
+    // Sim::Config::worldSnapshots / snapshotRestoreMask, allocated with
+    // allocSimBuffer. Snapshots taken by Manager::snapshot are copied out
+    // of snapshotStaging into their own buffer, indexed by handle.
+    WorldSnapshot *snapshotStaging;
+    int32_t *snapshotRestoreMask;
+    std::vector<WorldSnapshot *> snapshots;
+    MemoryStats memoryStats;
 
     inline Impl(const Manager::Config &mgr_cfg,
                 PhysicsLoader &&phys_loader,
                 WorldReset *reset_buffer,
+                WorldActive *active_buffer,
                 Action *action_buffer,
                 Optional<RenderGPUState> &&render_gpu_state,
                 Optional<render::RenderManager> &&render_mgr)
         : cfg(mgr_cfg),
           physicsLoader(std::move(phys_loader)),
           worldResetBuffer(reset_buffer),
+          worldActiveBuffer(active_buffer),
           agentActionsBuffer(action_buffer),
           renderGPUState(std::move(render_gpu_state)),
-          renderMgr(std::move(render_mgr))
+          renderMgr(std::move(render_mgr)),
+          stepInFlight(false),
+          sharedExportHeader(nullptr),
+          traceWriter(),
+          snapshotStaging(nullptr),
+          snapshotRestoreMask(nullptr),
+          snapshots(),
+          memoryStats()
     {}
 
-    inline virtual ~Impl() {}
+    inline virtual ~Impl()
+    {
+        for (WorldSnapshot *snapshot : snapshots) {
+            if (snapshot != nullptr) {
+                freeSimBuffer(cfg.execMode, snapshot);
+            }
+        }
+
+        freeSimBuffer(cfg.execMode, snapshotStaging);
+        freeSimBuffer(cfg.execMode, snapshotRestoreMask);
+    }
 
+    virtual void init() = 0;
     virtual void run() = 0;
 
+    // Runs TaskGraphID::Snapshot or TaskGraphID::Restore. These graphs don't
+    // consume the exported inputs, they only produce outputs.
+    virtual void runGraph(TaskGraphID graph_id) = 0;
+
+    // Backends that can't overlap the step with the caller just run
+    // synchronously here.
+    inline virtual void runAsync() { run(); }
+    inline virtual void waitAsync() {}
+
+    // Step profiling is only implemented by the CPU backend
+    inline virtual std::string profileReport() const { return ""; }
+    inline virtual void resetProfile() {}
+
+    virtual void * exportPtr(ExportID slot) const = 0;
+
     virtual Tensor exportTensor(ExportID slot,
         TensorElementType type,
         madrona::Span<const int64_t> dimensions) const = 0;
 
+    // Copies host memory into a buffer owned by the simulation backend
+    inline void copyToSim(void *dst, const void *src, size_t num_bytes)
+    {
+        if (cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+            cudaMemcpy(dst, src, num_bytes, cudaMemcpyHostToDevice);
+#endif
+        } else {
+            memcpy(dst, src, num_bytes);
+        }
+    }
+
+    // Copies out of a simulation owned buffer. dst may be host memory or,
+    // on the CUDA backend, device memory.
+    inline void copyFromSim(void *dst, const void *src, size_t num_bytes)
+    {
+        if (cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+            cudaMemcpy(dst, src, num_bytes, cudaMemcpyDefault);
+#endif
+        } else {
+            memcpy(dst, src, num_bytes);
+        }
+    }
+
+    inline void postStep()
+    {
+        if (renderMgr.has_value()) {
+            StepTraceWriter::Scope trace_scope(traceWriter.get(), "readECS");
+            renderMgr->readECS();
+        }
+
+        if (cfg.enableBatchRenderer) {
+            StepTraceWriter::Scope trace_scope(
+                traceWriter.get(), "batchRender");
+            renderMgr->batchRender();
+        }
+    }
+
     static inline Impl * init(const Config &cfg);
 };
 
@@ -123,31 +382,370 @@ struct Manager::CPUImpl final : Manager::Impl {
 
     TaskGraphT cpuExec;
 
+    // When Config::doubleBufferExports or Config::sharedMemoryName is set,
+    // every exported buffer has a manager-owned copy and the tensors handed
+    // to the caller point there. Inputs are copied into the executor when a
+    // step starts and outputs are copied back once it completes, so the
+    // caller can read the previous step's observations and write the next
+    // actions while stepAsync() is running. The copies live in exportStaging
+    // or, with sharedMemoryName, in a shared memory region other processes
+    // can map.
+    bool exportsStaged;
+    HeapArray<char> exportStaging;
+    std::unique_ptr<SharedExportRegion> sharedExports;
+    std::array<char *, (size_t)ExportID::NumExports> stagedExports;
+
+    // Driver thread for runAsync(), started by the first call and kept
+    // alive so each step only costs a wakeup. asyncStepPending is set by
+    // runAsync() and cleared by the thread once the step has run.
+    std::thread asyncStepThread;
+    std::mutex asyncStepMutex;
+    std::condition_variable asyncStepCV;
+    bool asyncStepPending;
+    bool asyncStepExit;
+
+    // Written by the profiling marker nodes in each world when
+    // Config::enableProfiling or Config::tracePath is set, empty otherwise.
+    HeapArray<WorldProfile> worldProfiles;
+    uint64_t profiledStepNS;
+    uint64_t numProfiledSteps;
+    // Per-world event buffers referenced by worldProfiles when tracing
+    HeapArray<ProfileEvent> traceEvents;
+
     inline CPUImpl(const Manager::Config &mgr_cfg,
                    PhysicsLoader &&phys_loader,
-                   WorldReset *reset_buffer,
-                   Action *action_buffer,
                    Optional<RenderGPUState> &&render_gpu_state,
                    Optional<render::RenderManager> &&render_mgr,
-                   TaskGraphT &&cpu_exec)
+                   TaskGraphT &&cpu_exec,
+                   HeapArray<WorldProfile> &&world_profiles)
         : Impl(mgr_cfg, std::move(phys_loader),
-               reset_buffer, action_buffer,
+               nullptr, nullptr, nullptr,
                std::move(render_gpu_state), std::move(render_mgr)),
-          cpuExec(std::move(cpu_exec))
-    {}
+          cpuExec(std::move(cpu_exec)),
+          exportsStaged(mgr_cfg.doubleBufferExports ||
+                        mgr_cfg.sharedMemoryName != nullptr),
+          exportStaging(exportsStaged && !mgr_cfg.sharedMemoryName ?
+              mgr_cfg.numWorlds * totalExportBytesPerWorld() : 0),
+          sharedExports(),
+          stagedExports(),
+          asyncStepThread(),
+          asyncStepMutex(),
+          asyncStepCV(),
+          asyncStepPending(false),
+          asyncStepExit(false),
+          worldProfiles(std::move(world_profiles)),
+          profiledStepNS(0),
+          numProfiledSteps(0),
+          traceEvents(mgr_cfg.tracePath != nullptr ?
+              mgr_cfg.numWorlds * (CountT)ProfileNode::NumNodes : 0)
+    {
+        if (mgr_cfg.tracePath != nullptr) {
+            traceWriter = std::make_unique<StepTraceWriter>(mgr_cfg.tracePath);
+
+            for (CountT i = 0; i < (CountT)mgr_cfg.numWorlds; i++) {
+                worldProfiles[i].traceEvents =
+                    traceEvents.data() + i * (CountT)ProfileNode::NumNodes;
+                worldProfiles[i].numTraceEvents = 0;
+            }
+        }
+
+        if (exportsStaged) {
+            uint64_t num_staging_bytes =
+                mgr_cfg.numWorlds * totalExportBytesPerWorld();
+
+            char *staging_base;
+            if (mgr_cfg.sharedMemoryName != nullptr) {
+                sharedExports = std::make_unique<SharedExportRegion>(
+                    mgr_cfg.sharedMemoryName, num_staging_bytes);
+                sharedExportHeader = sharedExports->header();
+                staging_base = sharedExports->buffers();
+            } else {
+                staging_base = exportStaging.data();
+            }
+
+            memset(staging_base, 0, num_staging_bytes);
+
+            char *cur = staging_base;
+            for (CountT i = 0; i < (CountT)ExportID::NumExports; i++) {
+                stagedExports[i] = cur;
+                cur += mgr_cfg.numWorlds * exportBytesPerWorld((ExportID)i);
+            }
+        }
+
+        worldResetBuffer = (WorldReset *)exportPtr(ExportID::Reset);
+        worldActiveBuffer = (WorldActive *)exportPtr(ExportID::Active);
+        agentActionsBuffer = (Action *)exportPtr(ExportID::Action);
+    }
+
+    inline virtual ~CPUImpl() final
+    {
+        if (asyncStepThread.joinable()) {
+            {
+                std::lock_guard lock(asyncStepMutex);
+                asyncStepExit = true;
+            }
+            asyncStepCV.notify_all();
+            asyncStepThread.join();
+        }
+    }
+
+    static inline uint64_t totalExportBytesPerWorld()
+    {
+        uint64_t num_bytes = 0;
+        for (CountT i = 0; i < (CountT)ExportID::NumExports; i++) {
+            num_bytes += exportBytesPerWorld((ExportID)i);
+        }
+
+        return num_bytes;
+    }
+
+    inline virtual void * exportPtr(ExportID slot) const final
+    {
+        if (exportsStaged) {
+            return stagedExports[(size_t)slot];
+        } else {
+            return cpuExec.getExported((uint32_t)slot);
+        }
+    }
+
+    inline void copyInStagedExports()
+    {
+        if (!exportsStaged) {
+            return;
+        }
+
+        for (CountT i = 0; i < (CountT)ExportID::NumExports; i++) {
+            ExportID slot = (ExportID)i;
+            if (!isInputExport(slot) || slot == ExportID::Reset) {
+                continue;
+            }
+
+            memcpy(cpuExec.getExported((uint32_t)slot), stagedExports[i],
+                   cfg.numWorlds * exportBytesPerWorld(slot));
+        }
+
+        // The simulation clears WorldReset once it has been consumed.
+        // Mirror that on the staged copy so resets aren't replayed. Each
+        // flag is taken with an exchange, so a reset another process writes
+        // into the shared region during the copy lands in this step or the
+        // next one instead of being cleared unseen.
+        auto staged_resets =
+            (WorldReset *)stagedExports[(size_t)ExportID::Reset];
+        auto sim_resets =
+            (WorldReset *)cpuExec.getExported((uint32_t)ExportID::Reset);
+
+        for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
+            sim_resets[i].reset = std::atomic_ref<int32_t>(
+                staged_resets[i].reset).exchange(0, std::memory_order_acq_rel);
+        }
+    }
+
+    inline void copyOutStagedExports()
+    {
+        if (!exportsStaged) {
+            return;
+        }
+
+        if (sharedExportHeader != nullptr) {
+            std::atomic_ref<uint64_t>(sharedExportHeader->stepSequence)
+                .fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        for (CountT i = 0; i < (CountT)ExportID::NumExports; i++) {
+            ExportID slot = (ExportID)i;
+            if (isInputExport(slot) || !isExportEnabled(cfg, slot)) {
+                continue;
+            }
+
+            memcpy(stagedExports[i], cpuExec.getExported((uint32_t)slot),
+                   cfg.numWorlds * exportBytesPerWorld(slot));
+        }
+
+        if (sharedExportHeader != nullptr) {
+            std::atomic_ref<uint64_t>(sharedExportHeader->stepSequence)
+                .fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    inline virtual void init()
+    {
+        copyInStagedExports();
+        cpuExec.runTaskGraph(TaskGraphID::Init);
+        copyOutStagedExports();
+    }
+
+    inline virtual void runGraph(TaskGraphID graph_id)
+    {
+        cpuExec.runTaskGraph(graph_id);
+        copyOutStagedExports();
+    }
+
+    inline void runStepGraph()
+    {
+        if (worldProfiles.size() == 0) {
+            cpuExec.runTaskGraph(TaskGraphID::Step);
+            return;
+        }
 
-    inline virtual ~CPUImpl() final {}
+        uint64_t start = StepTraceWriter::timestampNS();
+        cpuExec.runTaskGraph(TaskGraphID::Step);
+        uint64_t end = StepTraceWriter::timestampNS();
+
+        profiledStepNS += end - start;
+        numProfiledSteps += 1;
+
+        if (traceWriter) {
+            traceWriter->addSpan("Step", "manager", 0, start, end);
+            writeTraceEvents();
+        }
+    }
+
+    // Moves the sections recorded during the last step to the trace file
+    inline void writeTraceEvents()
+    {
+        for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
+            WorldProfile &world_profile = worldProfiles[i];
+
+            for (uint32_t j = 0; j < world_profile.numTraceEvents; j++) {
+                const ProfileEvent &event = world_profile.traceEvents[j];
+                traceWriter->addSpan(profileNodeName(event.node), "world",
+                    event.threadID, event.startNS, event.endNS, i);
+            }
+
+            world_profile.numTraceEvents = 0;
+        }
+    }
 
     inline virtual void run()
     {
-        cpuExec.run();
+        copyInStagedExports();
+        runStepGraph();
+        copyOutStagedExports();
+    }
+
+    // Body of asyncStepThread. A step that is pending when the Manager is
+    // destroyed still runs to completion before the thread exits.
+    inline void asyncStepLoop()
+    {
+        std::unique_lock lock(asyncStepMutex);
+        while (true) {
+            asyncStepCV.wait(lock, [this]() {
+                return asyncStepPending || asyncStepExit;
+            });
+
+            if (!asyncStepPending) {
+                return;
+            }
+
+            lock.unlock();
+            runStepGraph();
+            lock.lock();
+
+            asyncStepPending = false;
+            asyncStepCV.notify_all();
+        }
+    }
+
+    inline virtual void runAsync()
+    {
+        copyInStagedExports();
+
+        if (!asyncStepThread.joinable()) {
+            asyncStepThread = std::thread([this]() {
+                asyncStepLoop();
+            });
+        }
+
+        {
+            std::lock_guard lock(asyncStepMutex);
+            asyncStepPending = true;
+        }
+        asyncStepCV.notify_all();
+    }
+
+    inline virtual void waitAsync()
+    {
+        {
+            std::unique_lock lock(asyncStepMutex);
+            asyncStepCV.wait(lock, [this]() {
+                return !asyncStepPending;
+            });
+        }
+
+        copyOutStagedExports();
+    }
+
+    inline virtual std::string profileReport() const final
+    {
+        constexpr CountT num_nodes = (CountT)ProfileNode::NumNodes;
+
+        std::array<uint64_t, num_nodes> total_ns {};
+        std::array<uint64_t, num_nodes> invocations {};
+        for (const WorldProfile &world_profile : worldProfiles) {
+            for (CountT i = 0; i < num_nodes; i++) {
+                total_ns[i] += world_profile.totalNS[i];
+                invocations[i] += world_profile.invocations[i];
+            }
+        }
+
+        uint64_t all_sections_ns = 0;
+        for (CountT i = 0; i < num_nodes; i++) {
+            all_sections_ns += total_ns[i];
+        }
+
+        std::string report;
+        char line[256];
+
+        double wall_ms_per_step = numProfiledSteps == 0 ? 0.0 :
+            (double)profiledStepNS / (double)numProfiledSteps / 1e6;
+        snprintf(line, sizeof(line),
+                 "%llu steps, %.3f ms wall time per step, "
+                 "section times summed over %u worlds\n",
+                 (unsigned long long)numProfiledSteps, wall_ms_per_step,
+                 cfg.numWorlds);
+        report += line;
+
+        snprintf(line, sizeof(line), "%-22s %12s %12s %12s %8s\n",
+                 "section", "total ms", "calls", "us / call", "%");
+        report += line;
+
+        for (CountT i = 0; i < num_nodes; i++) {
+            if (invocations[i] == 0) {
+                continue;
+            }
+
+            snprintf(line, sizeof(line),
+                     "%-22s %12.3f %12llu %12.3f %7.2f%%\n",
+                     profileNodeName((ProfileNode)i),
+                     (double)total_ns[i] / 1e6,
+                     (unsigned long long)invocations[i],
+                     (double)total_ns[i] / (double)invocations[i] / 1e3,
+                     100.0 * (double)total_ns[i] /
+                         (double)std::max(all_sections_ns, (uint64_t)1));
+            report += line;
+        }
+
+        return report;
+    }
+
+    inline virtual void resetProfile() final
+    {
+        for (WorldProfile &world_profile : worldProfiles) {
+            for (CountT i = 0; i < (CountT)ProfileNode::NumNodes; i++) {
+                world_profile.totalNS[i] = 0;
+                world_profile.invocations[i] = 0;
+            }
+        }
+
+        profiledStepNS = 0;
+        numProfiledSteps = 0;
     }
 
     virtual inline Tensor exportTensor(ExportID slot,
         TensorElementType type,
         madrona::Span<const int64_t> dims) const final
     {
-        void *dev_ptr = cpuExec.getExported((uint32_t)slot);
+        void *dev_ptr = exportPtr(slot);
         return Tensor(dev_ptr, type, dims, Optional<int>::none());
     }
 };
@@ -156,33 +754,56 @@ struct Manager::CPUImpl final : Manager::Impl {
 struct Manager::CUDAImpl final : Manager::Impl {
     MWCudaExecutor gpuExec;
     MWCudaLaunchGraph stepGraph;
+    MWCudaLaunchGraph initGraph;
+    MWCudaLaunchGraph snapshotGraph;
+    MWCudaLaunchGraph restoreGraph;
 
     inline CUDAImpl(const Manager::Config &mgr_cfg,
                    PhysicsLoader &&phys_loader,
                    WorldReset *reset_buffer,
+                   WorldActive *active_buffer,
                    Action *action_buffer,
                    Optional<RenderGPUState> &&render_gpu_state,
                    Optional<render::RenderManager> &&render_mgr,
                    MWCudaExecutor &&gpu_exec)
         : Impl(mgr_cfg, std::move(phys_loader),
-               reset_buffer, action_buffer,
+               reset_buffer, active_buffer, action_buffer,
                std::move(render_gpu_state), std::move(render_mgr)),
           gpuExec(std::move(gpu_exec)),
-          stepGraph(gpuExec.buildLaunchGraphAllTaskGraphs())
+          stepGraph(gpuExec.buildLaunchGraph(TaskGraphID::Step)),
+          initGraph(gpuExec.buildLaunchGraph(TaskGraphID::Init)),
+          snapshotGraph(gpuExec.buildLaunchGraph(TaskGraphID::Snapshot)),
+          restoreGraph(gpuExec.buildLaunchGraph(TaskGraphID::Restore))
     {}
 
     inline virtual ~CUDAImpl() final {}
 
+    inline virtual void init()
+    {
+        gpuExec.run(initGraph);
+    }
+
     inline virtual void run()
     {
         gpuExec.run(stepGraph);
     }
 
+    inline virtual void runGraph(TaskGraphID graph_id)
+    {
+        gpuExec.run(graph_id == TaskGraphID::Snapshot ?
+            snapshotGraph : restoreGraph);
+    }
+
+    inline virtual void * exportPtr(ExportID slot) const final
+    {
+        return gpuExec.getExported((uint32_t)slot);
+    }
+
     virtual inline Tensor exportTensor(ExportID slot,
         TensorElementType type,
         madrona::Span<const int64_t> dims) const final
     {
-        void *dev_ptr = gpuExec.getExported((uint32_t)slot);
+        void *dev_ptr = exportPtr(slot);
         return Tensor(dev_ptr, type, dims, cfg.gpuID);
     }
 };
@@ -258,7 +879,54 @@ static void loadRenderObjects(render::RenderManager &render_mgr)
     });
 }
 
-static void loadPhysicsObjects(PhysicsLoader &loader)
+// Simple 64 bit word-at-a-time hash for state checksums and asset cache
+// keys. Only needs to be stable and sensitive to single bit changes, not
+// cryptographically strong.
+static uint64_t hashBytes(const void *data, uint64_t num_bytes, uint64_t h)
+{
+    constexpr uint64_t mul = 0x9e3779b97f4a7c15ull;
+
+    const char *cur = (const char *)data;
+    const char *end = cur + num_bytes;
+
+    for (; cur + sizeof(uint64_t) <= end; cur += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, cur, sizeof(uint64_t));
+        h = (h ^ word) * mul;
+        h ^= h >> 32;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, cur, end - cur);
+    h = (h ^ tail ^ num_bytes) * mul;
+    h ^= h >> 29;
+
+    return h;
+}
+
+// Collision parameters of each SimObject loaded from disk
+struct PhysicsObjectParams {
+    SimObject obj;
+    float invMass;
+    RigidBodyFrictionData friction;
+};
+
+static const std::array<PhysicsObjectParams,
+                        (size_t)SimObject::NumObjects - 1> physicsObjectParams {{
+    { SimObject::Cube, 0.075f, { .muS = 0.5f, .muD = 0.75f } },
+    { SimObject::Wall, 0.f, { .muS = 0.5f, .muD = 0.5f } },
+    { SimObject::Door, 0.f, { .muS = 0.5f, .muD = 0.5f } },
+    { SimObject::Agent, 1.f, { .muS = 0.5f, .muD = 0.5f } },
+    { SimObject::Button, 1.f, { .muS = 0.5f, .muD = 0.5f } },
+}};
+
+static const RigidBodyFrictionData planeFriction {
+    .muS = 0.5f,
+    .muD = 0.5f,
+};
+
+static std::array<std::string, (size_t)SimObject::NumObjects - 1>
+    physicsAssetPaths()
 {
     std::array<std::string, (size_t)SimObject::NumObjects - 1> asset_paths;
     asset_paths[(size_t)SimObject::Cube] =
@@ -272,9 +940,54 @@ static void loadPhysicsObjects(PhysicsLoader &loader)
     asset_paths[(size_t)SimObject::Button] =
         (std::filesystem::path(DATA_DIR) / "cube_collision.obj").string();
 
+    return asset_paths;
+}
+
+// Key of the asset cache entry: everything processRigidBodyAssets' output
+// depends on, i.e. the madrona revision implementing it (MADRONA_BUILD_ID,
+// set in src/CMakeLists.txt), the source meshes and the collision parameters.
+static uint64_t physicsAssetKey(
+    const std::array<std::string, (size_t)SimObject::NumObjects - 1> &paths)
+{
+    uint64_t h = hashBytes(&assetCacheVersion, sizeof(assetCacheVersion),
+                           0xcbf29ce484222325ull);
+
+    const char madrona_build_id[] = MADRONA_BUILD_ID;
+    h = hashBytes(madrona_build_id, sizeof(madrona_build_id) - 1, h);
+
+    for (const std::string &path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+        if (!file.good() && !file.eof()) {
+            FATAL("Failed to read %s", path.c_str());
+        }
+
+        h = hashBytes(contents.data(), contents.size(), h);
+    }
+
+    for (const PhysicsObjectParams &params : physicsObjectParams) {
+        h = hashBytes(&params.obj, sizeof(params.obj), h);
+        h = hashBytes(&params.invMass, sizeof(params.invMass), h);
+        h = hashBytes(&params.friction, sizeof(params.friction), h);
+    }
+
+    return hashBytes(&planeFriction, sizeof(planeFriction), h);
+}
+
+// Imports the collision meshes and runs processRigidBodyAssets on them
+// num_runs (1 or 2) times, writing each run's output to assets[i] and
+// num_data_bytes[i]. Storing an asset cache entry needs a second,
+// independent run. The returned data blobs must be freed by the caller.
+static std::array<void *, 2> processPhysicsObjects(
+    const std::array<std::string, (size_t)SimObject::NumObjects - 1> &paths,
+    CountT num_runs,
+    RigidBodyAssets *assets,
+    uint64_t *num_data_bytes)
+{
     std::array<const char *, (size_t)SimObject::NumObjects - 1> asset_cstrs;
-    for (size_t i = 0; i < asset_paths.size(); i++) {
-        asset_cstrs[i] = asset_paths[i].c_str();
+    for (size_t i = 0; i < paths.size(); i++) {
+        asset_cstrs[i] = paths[i].c_str();
     }
 
     imp::AssetImporter importer;
@@ -319,30 +1032,9 @@ static void loadPhysicsObjects(PhysicsLoader &loader)
         };
     };
 
-    setupHull(SimObject::Cube, 0.075f, {
-        .muS = 0.5f,
-        .muD = 0.75f,
-    });
-
-    setupHull(SimObject::Wall, 0.f, {
-        .muS = 0.5f,
-        .muD = 0.5f,
-    });
-
-    setupHull(SimObject::Door, 0.f, {
-        .muS = 0.5f,
-        .muD = 0.5f,
-    });
-
-    setupHull(SimObject::Agent, 1.f, {
-        .muS = 0.5f,
-        .muD = 0.5f,
-    });
-
-    setupHull(SimObject::Button, 1.f, {
-        .muS = 0.5f,
-        .muD = 0.5f,
-    });
+    for (const PhysicsObjectParams &params : physicsObjectParams) {
+        setupHull(params.obj, params.invMass, params.friction);
+    }
 
     SourceCollisionPrimitive plane_prim {
         .type = CollisionPrimitive::Type::Plane,
@@ -352,62 +1044,404 @@ static void loadPhysicsObjects(PhysicsLoader &loader)
     src_objs[(CountT)SimObject::Plane] = {
         .prims = Span<const SourceCollisionPrimitive>(&plane_prim, 1),
         .invMass = 0.f,
-        .friction = {
-            .muS = 0.5f,
-            .muD = 0.5f,
-        },
+        .friction = planeFriction,
     };
 
-    StackAlloc tmp_alloc;
-    RigidBodyAssets rigid_body_assets;
-    CountT num_rigid_body_data_bytes;
-    void *rigid_body_data = RigidBodyAssets::processRigidBodyAssets(
-        src_convex_hulls,
-        src_objs,
-        false,
-        tmp_alloc,
-        &rigid_body_assets,
-        &num_rigid_body_data_bytes);
+    std::array<void *, 2> rigid_body_data { nullptr, nullptr };
+    for (CountT i = 0; i < num_runs; i++) {
+        StackAlloc tmp_alloc;
+        CountT num_bytes;
+        rigid_body_data[i] = RigidBodyAssets::processRigidBodyAssets(
+            src_convex_hulls,
+            src_objs,
+            false,
+            tmp_alloc,
+            &assets[i],
+            &num_bytes);
+
+        if (rigid_body_data[i] == nullptr) {
+            FATAL("Invalid collision hull input");
+        }
+
+        num_data_bytes[i] = (uint64_t)num_bytes;
+    }
 
-    if (rigid_body_data == nullptr) {
-        FATAL("Invalid collision hull input");
+    return rigid_body_data;
+}
+
+// Returns the size of the processed rigid body asset data. With a cache
+// directory, reuses the processed assets of an earlier run when the source
+// meshes and parameters haven't changed, skipping the import and hull
+// processing.
+static uint64_t loadPhysicsObjects(PhysicsLoader &loader,
+                                   const char *asset_cache_dir)
+{
+    std::array<std::string, (size_t)SimObject::NumObjects - 1> asset_paths =
+        physicsAssetPaths();
+
+    std::unique_ptr<RigidBodyAssetCache> asset_cache;
+    if (asset_cache_dir != nullptr) {
+        asset_cache = std::make_unique<RigidBodyAssetCache>(
+            asset_cache_dir, physicsAssetKey(asset_paths));
+    }
+
+    std::array<RigidBodyAssets, 2> rigid_body_assets;
+    std::array<uint64_t, 2> num_rigid_body_data_bytes { 0, 0 };
+    std::array<void *, 2> rigid_body_data { nullptr, nullptr };
+
+    if (!asset_cache || !asset_cache->load(&rigid_body_assets[0],
+                                           &num_rigid_body_data_bytes[0])) {
+        CountT num_runs = asset_cache ? 2 : 1;
+        rigid_body_data = processPhysicsObjects(asset_paths, num_runs,
+            rigid_body_assets.data(), num_rigid_body_data_bytes.data());
+
+        if (asset_cache && (
+                num_rigid_body_data_bytes[0] != num_rigid_body_data_bytes[1] ||
+                !asset_cache->store(rigid_body_assets[0], rigid_body_data[0],
+                                    rigid_body_assets[1], rigid_body_data[1],
+                                    num_rigid_body_data_bytes[0]))) {
+            fprintf(stderr, "Failed to write physics asset cache entry %s\n",
+                    asset_cache->path().c_str());
+        }
     }
 
     // This is a bit hacky, but in order to make sure the agents
     // remain controllable by the policy, they are only allowed to
     // rotate around the Z axis (infinite inertia in x & y axes)
-    rigid_body_assets.metadatas[
+    rigid_body_assets[0].metadatas[
         (CountT)SimObject::Agent].mass.invInertiaTensor.x = 0.f;
-    rigid_body_assets.metadatas[
+    rigid_body_assets[0].metadatas[
         (CountT)SimObject::Agent].mass.invInertiaTensor.y = 0.f;
 
-    loader.loadRigidBodies(rigid_body_assets);
-    free(rigid_body_data);
+    loader.loadRigidBodies(rigid_body_assets[0]);
+    free(rigid_body_data[0]);
+    free(rigid_body_data[1]);
+
+    return num_rigid_body_data_bytes[0];
 }
 
-Manager::Impl * Manager::Impl::init(
-    const Manager::Config &mgr_cfg)
-{
-    Sim::Config sim_cfg;
-    sim_cfg.autoReset = mgr_cfg.autoReset;
-    sim_cfg.initRandKey = rand::initKey(mgr_cfg.randSeed);
+// Restricts the calling thread to the CPUs requested by the config for the
+// lifetime of the object. Threads spawned meanwhile (the executor's workers)
+// inherit the mask, and with numaNode set, memory first touched by this
+// thread is preferentially placed on that node. The caller's original
+// affinity and memory policy are restored on destruction.
+class CPUPlacement {
+public:
+    CPUPlacement(const Manager::Config &mgr_cfg)
+        : num_cpus_(0)
+    {
+        if (mgr_cfg.numaNode < 0 && mgr_cfg.numPinnedCPUs == 0) {
+            return;
+        }
 
-    switch (mgr_cfg.execMode) {
-    case ExecMode::CUDA: {
-#ifdef MADRONA_CUDA_SUPPORT
-        CUcontext cu_ctx = MWCudaExecutor::initCUDA(mgr_cfg.gpuID);
+#ifdef MADRONA_LINUX
+        if (mgr_cfg.numaNode >= maxNUMANodes) {
+            FATAL("NUMA node %d is out of range, at most %d are supported",
+                  mgr_cfg.numaNode, maxNUMANodes);
+        }
 
-        PhysicsLoader phys_loader(ExecMode::CUDA, 10);
-        loadPhysicsObjects(phys_loader);
+        DynArray<int32_t> cpus(0);
+        if (mgr_cfg.numaNode >= 0) {
+            readNodeCPUs(mgr_cfg.numaNode, cpus);
+        } else {
+            for (uint32_t i = 0; i < mgr_cfg.numPinnedCPUs; i++) {
+                cpus.push_back(mgr_cfg.pinnedCPUs[i]);
+            }
+        }
 
-        ObjectManager *phys_obj_mgr = &phys_loader.getObjectManager();
-        sim_cfg.rigidBodyObjMgr = phys_obj_mgr;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int32_t cpu : cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                FATAL("Invalid CPU index %d", cpu);
+            }
+            CPU_SET(cpu, &mask);
+        }
 
-        Optional<RenderGPUState> render_gpu_state =
-            initRenderGPUState(mgr_cfg);
+        if (sched_getaffinity(0, sizeof(prev_mask_), &prev_mask_) != 0 ||
+                sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+            FATAL("Failed to set CPU affinity");
+        }
 
-        Optional<render::RenderManager> render_mgr =
-            initRenderManager(mgr_cfg, render_gpu_state);
+        num_cpus_ = (uint32_t)CPU_COUNT(&mask);
+
+        if (mgr_cfg.numaNode >= 0) {
+            // Preferred rather than bound, so allocations fall back to other
+            // nodes when this one is full rather than failing. Worker
+            // threads inherit the policy. The kernel reads maxnode - 1 bits
+            // of the mask. The caller's policy (e.g. from numactl) is saved
+            // first so it can be put back.
+            unsigned long node_mask[nodeMaskWords] = {};
+            node_mask[mgr_cfg.numaNode / nodeMaskWordBits] =
+                1ul << (mgr_cfg.numaNode % nodeMaskWordBits);
+
+            if (syscall(SYS_get_mempolicy, &prev_policy_, prev_node_mask_,
+                        (unsigned long)maxNUMANodes, nullptr, 0) != 0 ||
+                    syscall(SYS_set_mempolicy, mpolPreferred, node_mask,
+                        (unsigned long)maxNUMANodes + 1) != 0) {
+                FATAL("Failed to prefer NUMA node %d for allocations: %s",
+                      mgr_cfg.numaNode, strerror(errno));
+            }
+            set_mempolicy_ = true;
+        }
+#else
+        FATAL("CPU pinning is only supported on Linux");
+#endif
+    }
+
+    ~CPUPlacement()
+    {
+#ifdef MADRONA_LINUX
+        if (num_cpus_ == 0) {
+            return;
+        }
+
+        sched_setaffinity(0, sizeof(prev_mask_), &prev_mask_);
+
+        if (set_mempolicy_) {
+            syscall(SYS_set_mempolicy, prev_policy_, prev_node_mask_,
+                    (unsigned long)maxNUMANodes + 1);
+        }
+#endif
+    }
+
+    CPUPlacement(const CPUPlacement &) = delete;
+
+    // Number of CPUs the threads are restricted to, 0 if unrestricted.
+    uint32_t numCPUs() const { return num_cpus_; }
+
+private:
+#ifdef MADRONA_LINUX
+    // /sys/devices/system/node/nodeN/cpulist holds comma separated CPUs
+    // and ranges, e.g. "0-15,32-47".
+    static void readNodeCPUs(int32_t node, DynArray<int32_t> &cpus)
+    {
+        std::string path = "/sys/devices/system/node/node" +
+            std::to_string(node) + "/cpulist";
+        std::ifstream cpulist_file(path);
+        std::string cpulist;
+        if (!std::getline(cpulist_file, cpulist)) {
+            FATAL("Failed to read CPU list for NUMA node %d", node);
+        }
+
+        const char *cur = cpulist.data();
+        const char *end = cur + cpulist.size();
+        while (cur < end) {
+            int32_t first, last;
+            auto res = std::from_chars(cur, end, first);
+            if (res.ec != std::errc()) {
+                break;
+            }
+            cur = res.ptr;
+            last = first;
+
+            if (cur < end && *cur == '-') {
+                res = std::from_chars(cur + 1, end, last);
+                if (res.ec != std::errc()) {
+                    break;
+                }
+                cur = res.ptr;
+            }
+
+            for (int32_t cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+
+            if (cur < end && *cur == ',') {
+                cur++;
+            } else {
+                break;
+            }
+        }
+
+        if (cpus.size() == 0) {
+            FATAL("NUMA node %d has no CPUs", node);
+        }
+    }
+
+    // MPOL_PREFERRED from <linux/mempolicy.h>
+    static constexpr int mpolPreferred = 1;
+    static constexpr int32_t maxNUMANodes = 1024;
+    static constexpr int32_t nodeMaskWordBits = sizeof(unsigned long) * 8;
+    static constexpr int32_t nodeMaskWords = maxNUMANodes / nodeMaskWordBits;
+
+    cpu_set_t prev_mask_;
+    // Mode and node mask from get_mempolicy
+    int prev_policy_ = 0;
+    unsigned long prev_node_mask_[nodeMaskWords] = {};
+    bool set_mempolicy_ = false;
+#endif
+    uint32_t num_cpus_;
+};
+
+// Per-entity storage of one archetype's table, for memoryReport()
+struct ArchetypeLayout {
+    const char *name;
+    // Upper bound on the number of these entities in a world
+    CountT maxEntities;
+    std::vector<std::pair<const char *, uint64_t>> components;
+};
+
+static std::array<ArchetypeLayout, 4> archetypeLayouts()
+{
+    using namespace madrona::render;
+
+    // Every table row also stores the entity's ID and world
+    std::vector<std::pair<const char *, uint64_t>> row_header {
+        { "Entity", sizeof(Entity) },
+        { "WorldID", sizeof(WorldID) },
+    };
+
+    // Components of the RigidBody bundle the game reads and writes. The
+    // bundle's physics solver internals aren't listed, they are part of the
+    // measured executor memory.
+    std::vector<std::pair<const char *, uint64_t>> rigid_body {
+        { "Position", sizeof(Position) },
+        { "Rotation", sizeof(Rotation) },
+        { "Scale", sizeof(Scale) },
+        { "ObjectID", sizeof(ObjectID) },
+        { "ResponseType", sizeof(ResponseType) },
+        { "Velocity", sizeof(Velocity) },
+        { "ExternalForce", sizeof(ExternalForce) },
+        { "ExternalTorque", sizeof(ExternalTorque) },
+    };
+
+    auto concat = [](std::vector<std::pair<const char *, uint64_t>> a,
+                     std::initializer_list<
+                         std::pair<const char *, uint64_t>> b) {
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+    };
+
+    auto with_rigid_body = row_header;
+    with_rigid_body.insert(with_rigid_body.end(),
+                           rigid_body.begin(), rigid_body.end());
+
+    constexpr CountT max_room_entities =
+        consts::numRooms * consts::maxEntitiesPerRoom;
+
+    return {{
+        {
+            "Agent", consts::numAgents,
+            concat(with_rigid_body, {
+                { "GrabState", sizeof(GrabState) },
+                { "Progress", sizeof(Progress) },
+                { "OtherAgents", sizeof(OtherAgents) },
+                { "EntityType", sizeof(EntityType) },
+                { "LastPose", sizeof(LastPose) },
+                { "Action", sizeof(Action) },
+                { "SelfObservation", sizeof(SelfObservation) },
+                { "PartnerObservations", sizeof(PartnerObservations) },
+                { "RoomEntityObservations", sizeof(RoomEntityObservations) },
+                { "DoorObservation", sizeof(DoorObservation) },
+                { "Lidar", sizeof(Lidar) },
+                { "CompactLidar", sizeof(CompactLidar) },
+                { "StepsRemaining", sizeof(StepsRemaining) },
+                { "FlatObservation", sizeof(FlatObservation) },
+                { "HalfObservation", sizeof(HalfObservation) },
+                { "Reward", sizeof(Reward) },
+                { "Done", sizeof(Done) },
+                { "RenderCamera", sizeof(RenderCamera) },
+                { "Renderable", sizeof(Renderable) },
+            }),
+        },
+        {
+            // Cubes, room walls, border walls and the floor
+            "PhysicsEntity",
+            max_room_entities + consts::numRooms * 2 + 4,
+            concat(with_rigid_body, {
+                { "EntityType", sizeof(EntityType) },
+                { "LastPose", sizeof(LastPose) },
+                { "Renderable", sizeof(Renderable) },
+            }),
+        },
+        {
+            "DoorEntity", consts::numRooms,
+            concat(with_rigid_body, {
+                { "OpenState", sizeof(OpenState) },
+                { "DoorProperties", sizeof(DoorProperties) },
+                { "EntityType", sizeof(EntityType) },
+                { "LastPose", sizeof(LastPose) },
+                { "Renderable", sizeof(Renderable) },
+            }),
+        },
+        {
+            "ButtonEntity", max_room_entities,
+            concat(row_header, {
+                { "Position", sizeof(Position) },
+                { "Rotation", sizeof(Rotation) },
+                { "Scale", sizeof(Scale) },
+                { "ObjectID", sizeof(ObjectID) },
+                { "ButtonState", sizeof(ButtonState) },
+                { "EntityType", sizeof(EntityType) },
+                { "Renderable", sizeof(Renderable) },
+            }),
+        },
+    }};
+}
+
+Manager::Impl * Manager::Impl::init(
+    const Manager::Config &mgr_cfg)
+{
+    Sim::Config sim_cfg;
+    sim_cfg.autoReset = mgr_cfg.autoReset;
+    sim_cfg.initRandKey = rand::initKey(mgr_cfg.randSeed);
+    sim_cfg.worldProfiles = nullptr;
+    sim_cfg.flatObservations = mgr_cfg.flatObservations;
+    sim_cfg.obsPrecision = mgr_cfg.obsPrecision;
+    sim_cfg.compactLidar = mgr_cfg.compactLidar;
+
+    if (mgr_cfg.numLidarSamples == 0 ||
+            mgr_cfg.numLidarSamples > consts::numLidarSamples) {
+        FATAL("numLidarSamples must be between 1 and %d, got %u",
+              (int)consts::numLidarSamples, mgr_cfg.numLidarSamples);
+    }
+
+    if (!(mgr_cfg.lidarSpan > 0.f) || !(mgr_cfg.lidarMaxRange > 0.f)) {
+        FATAL("lidarSpan and lidarMaxRange must be positive");
+    }
+
+    sim_cfg.numLidarSamples = (int32_t)mgr_cfg.numLidarSamples;
+    sim_cfg.lidarSpan = mgr_cfg.lidarSpan;
+    sim_cfg.lidarMaxRange = mgr_cfg.lidarMaxRange;
+    sim_cfg.lidarCaching = mgr_cfg.lidarCaching;
+
+    auto snapshot_staging = (WorldSnapshot *)allocSimBuffer(
+        mgr_cfg.execMode, sizeof(WorldSnapshot) * mgr_cfg.numWorlds);
+    auto snapshot_restore_mask = (int32_t *)allocSimBuffer(
+        mgr_cfg.execMode, sizeof(int32_t) * mgr_cfg.numWorlds);
+    sim_cfg.worldSnapshots = snapshot_staging;
+    sim_cfg.snapshotRestoreMask = snapshot_restore_mask;
+
+    switch (mgr_cfg.execMode) {
+    case ExecMode::CUDA: {
+#ifdef MADRONA_CUDA_SUPPORT
+        if (mgr_cfg.doubleBufferExports ||
+                mgr_cfg.sharedMemoryName != nullptr) {
+            FATAL("Double buffered and shared memory exports are only "
+                  "supported on the CPU backend");
+        }
+
+        if (mgr_cfg.enableProfiling || mgr_cfg.tracePath != nullptr) {
+            FATAL("Step profiling and tracing are only supported on the "
+                  "CPU backend");
+        }
+
+        CUcontext cu_ctx = MWCudaExecutor::initCUDA(mgr_cfg.gpuID);
+
+        PhysicsLoader phys_loader(ExecMode::CUDA, 10);
+        MemoryStats memory_stats;
+        memory_stats.assetBytes =
+            loadPhysicsObjects(phys_loader, mgr_cfg.assetCacheDir);
+
+        ObjectManager *phys_obj_mgr = &phys_loader.getObjectManager();
+        sim_cfg.rigidBodyObjMgr = phys_obj_mgr;
+
+        Optional<RenderGPUState> render_gpu_state =
+            initRenderGPUState(mgr_cfg);
+
+        Optional<render::RenderManager> render_mgr =
+            initRenderManager(mgr_cfg, render_gpu_state);
 
         if (render_mgr.has_value()) {
             loadRenderObjects(*render_mgr);
@@ -418,6 +1452,9 @@ Manager::Impl * Manager::Impl::init(
 
         HeapArray<Sim::WorldInit> world_inits(mgr_cfg.numWorlds);
 
+        size_t free_before_exec, total_device_bytes;
+        REQ_CUDA(cudaMemGetInfo(&free_before_exec, &total_device_bytes));
+
         MWCudaExecutor gpu_exec({
             .worldInitPtr = world_inits.data(),
             .numWorldInitBytes = sizeof(Sim::WorldInit),
@@ -426,7 +1463,7 @@ Manager::Impl * Manager::Impl::init(
             .numWorldDataBytes = sizeof(Sim),
             .worldDataAlignment = alignof(Sim),
             .numWorlds = mgr_cfg.numWorlds,
-            .numTaskGraphs = 1,
+            .numTaskGraphs = (uint32_t)TaskGraphID::NumTaskGraphs,
             .numExportedBuffers = (uint32_t)ExportID::NumExports, 
         }, {
             { GPU_HIDESEEK_SRC_LIST },
@@ -434,28 +1471,45 @@ Manager::Impl * Manager::Impl::init(
             CompileConfig::OptMode::LTO,
         }, cu_ctx);
 
+        size_t free_after_exec;
+        REQ_CUDA(cudaMemGetInfo(&free_after_exec, &total_device_bytes));
+        memory_stats.executorBytes = free_before_exec > free_after_exec ?
+            free_before_exec - free_after_exec : 0;
+
         WorldReset *world_reset_buffer = 
             (WorldReset *)gpu_exec.getExported((uint32_t)ExportID::Reset);
 
+        WorldActive *world_active_buffer = 
+            (WorldActive *)gpu_exec.getExported((uint32_t)ExportID::Active);
+
         Action *agent_actions_buffer = 
             (Action *)gpu_exec.getExported((uint32_t)ExportID::Action);
 
-        return new CUDAImpl {
+        auto cuda_impl = new CUDAImpl {
             mgr_cfg,
             std::move(phys_loader),
             world_reset_buffer,
+            world_active_buffer,
             agent_actions_buffer,
             std::move(render_gpu_state),
             std::move(render_mgr),
             std::move(gpu_exec),
         };
+
+        cuda_impl->snapshotStaging = snapshot_staging;
+        cuda_impl->snapshotRestoreMask = snapshot_restore_mask;
+        cuda_impl->memoryStats = memory_stats;
+
+        return cuda_impl;
 #else
         FATAL("Madrona was not compiled with CUDA support");
 #endif
     } break;
     case ExecMode::CPU: {
         PhysicsLoader phys_loader(ExecMode::CPU, 10);
-        loadPhysicsObjects(phys_loader);
+        MemoryStats memory_stats;
+        memory_stats.assetBytes =
+            loadPhysicsObjects(phys_loader, mgr_cfg.assetCacheDir);
 
         ObjectManager *phys_obj_mgr = &phys_loader.getObjectManager();
         sim_cfg.rigidBodyObjMgr = phys_obj_mgr;
@@ -475,32 +1529,59 @@ Manager::Impl * Manager::Impl::init(
 
         HeapArray<Sim::WorldInit> world_inits(mgr_cfg.numWorlds);
 
+        bool profile_worlds =
+            mgr_cfg.enableProfiling || mgr_cfg.tracePath != nullptr;
+
+        HeapArray<WorldProfile> world_profiles(
+            profile_worlds ? mgr_cfg.numWorlds : 0);
+        for (WorldProfile &world_profile : world_profiles) {
+            world_profile = {};
+        }
+
+        if (profile_worlds) {
+            sim_cfg.worldProfiles = world_profiles.data();
+        }
+
+        // Worker threads and the worlds' ECS tables are created inside the
+        // executor constructor, so placement only needs to cover it.
+        CPUPlacement placement(mgr_cfg);
+
+        uint32_t num_workers = mgr_cfg.numWorkers;
+        if (num_workers == 0) {
+            num_workers = placement.numCPUs();
+        }
+
+        uint64_t resident_before_exec = residentBytes();
+
         CPUImpl::TaskGraphT cpu_exec {
             ThreadPoolExecutor::Config {
                 .numWorlds = mgr_cfg.numWorlds,
                 .numExportedBuffers = (uint32_t)ExportID::NumExports,
+                .numWorkers = num_workers,
             },
             sim_cfg,
             world_inits.data(),
             (uint32_t)TaskGraphID::NumTaskGraphs,
         };
 
-        WorldReset *world_reset_buffer = 
-            (WorldReset *)cpu_exec.getExported((uint32_t)ExportID::Reset);
-
-        Action *agent_actions_buffer = 
-            (Action *)cpu_exec.getExported((uint32_t)ExportID::Action);
+        uint64_t resident_after_exec = residentBytes();
+        memory_stats.executorBytes =
+            resident_after_exec > resident_before_exec ?
+                resident_after_exec - resident_before_exec : 0;
 
         auto cpu_impl = new CPUImpl {
             mgr_cfg,
             std::move(phys_loader),
-            world_reset_buffer,
-            agent_actions_buffer,
             std::move(render_gpu_state),
             std::move(render_mgr),
             std::move(cpu_exec),
+            std::move(world_profiles),
         };
 
+        cpu_impl->snapshotStaging = snapshot_staging;
+        cpu_impl->snapshotRestoreMask = snapshot_restore_mask;
+        cpu_impl->memoryStats = memory_stats;
+
         return cpu_impl;
     } break;
     default: MADRONA_UNREACHABLE();
@@ -510,34 +1591,373 @@ Manager::Impl * Manager::Impl::init(
 Manager::Manager(const Config &cfg)
     : impl_(Impl::init(cfg))
 {
-    // Currently, there is no way to populate the initial set of observations
-    // without stepping the simulations in order to execute the taskgraph.
-    // Therefore, after setup, we step all the simulations with a forced reset
-    // that ensures the first real step will have valid observations at the
-    // start of a fresh episode in order to compute actions.
-    //
-    // This will be improved in the future with support for multiple task
-    // graphs, allowing a small task graph to be executed after initialization.
-    
-    for (int32_t i = 0; i < (int32_t)cfg.numWorlds; i++) {
-        triggerReset(i);
+    // Give the exported inputs a defined initial state: no pending resets
+    // and all worlds active.
+    {
+        HeapArray<WorldReset> no_resets(cfg.numWorlds);
+        HeapArray<WorldActive> all_active(cfg.numWorlds);
+        for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
+            no_resets[i].reset = 0;
+            all_active[i].active = 1;
+        }
+
+        impl_->copyToSim(impl_->worldResetBuffer, no_resets.data(),
+                         sizeof(WorldReset) * cfg.numWorlds);
+        impl_->copyToSim(impl_->worldActiveBuffer, all_active.data(),
+                         sizeof(WorldActive) * cfg.numWorlds);
+    }
+
+    if (impl_->sharedExportHeader != nullptr) {
+        describeSharedExports();
     }
 
-    step();
+    // The worlds were generated during executor construction (Sim::Sim).
+    // Run the Init task graph to build the BVH and populate the initial
+    // set of observations, so the first real step has valid inputs at the
+    // start of a fresh episode without taking a physics step.
+    impl_->init();
+    impl_->postStep();
 }
 
 Manager::~Manager() {}
 
+// Fills in the shapes of the exported tensors in the shared memory header
+// so consumers in other processes can interpret the buffers.
+void Manager::describeSharedExports()
+{
+    SharedExportHeader *hdr = impl_->sharedExportHeader;
+    const char *region_base = (const char *)hdr;
+
+    auto describe = [&](ExportID slot, const Tensor &tensor) {
+        SharedExportDesc &desc = hdr->exports[(uint32_t)slot];
+        desc.offset = (uint64_t)((const char *)impl_->exportPtr(slot) -
+            region_base);
+        desc.numBytes = impl_->cfg.numWorlds * exportBytesPerWorld(slot);
+        desc.elementType = (uint32_t)tensor.type();
+        desc.numDims = (uint32_t)tensor.numDims();
+        for (int64_t i = 0; i < tensor.numDims(); i++) {
+            desc.dims[i] = tensor.dims()[i];
+        }
+    };
+
+    describe(ExportID::Reset, resetTensor());
+    describe(ExportID::Active, activeTensor());
+    describe(ExportID::Action, actionTensor());
+    describe(ExportID::Reward, rewardTensor());
+    describe(ExportID::Done, doneTensor());
+    describe(ExportID::SelfObservation, selfObservationTensor());
+    describe(ExportID::PartnerObservations, partnerObservationsTensor());
+    describe(ExportID::RoomEntityObservations,
+             roomEntityObservationsTensor());
+    describe(ExportID::DoorObservation, doorObservationTensor());
+    describe(ExportID::Lidar, lidarTensor());
+    describe(ExportID::StepsRemaining, stepsRemainingTensor());
+    describe(ExportID::FlatObservation, flatObservationTensor());
+    describe(ExportID::HalfObservation, halfObservationTensor());
+    describe(ExportID::CompactLidar, compactLidarTensor());
+
+    hdr->numWorlds = impl_->cfg.numWorlds;
+    hdr->numAgents = consts::numAgents;
+    hdr->numExports = (uint32_t)ExportID::NumExports;
+}
+
 void Manager::step()
 {
+    if (impl_->stepInFlight) {
+        FATAL("Manager::step called while an async step is in flight");
+    }
+
     impl_->run();
+    impl_->postStep();
+}
+
+void Manager::stepAsync()
+{
+    if (impl_->stepInFlight) {
+        FATAL("Manager::stepAsync called before wait()");
+    }
 
-    if (impl_->renderMgr.has_value()) {
-        impl_->renderMgr->readECS();
+    // Unstaged exports alias the executor's columns, which the step writes
+    // while the caller is free to read them.
+    const Config &cfg = impl_->cfg;
+    if (cfg.execMode == ExecMode::CPU && !cfg.doubleBufferExports &&
+            cfg.sharedMemoryName == nullptr) {
+        FATAL("Manager::stepAsync requires Config::doubleBufferExports or "
+              "Config::sharedMemoryName on the CPU backend");
     }
 
-    if (impl_->cfg.enableBatchRenderer) {
-        impl_->renderMgr->batchRender();
+    impl_->runAsync();
+    impl_->stepInFlight = true;
+}
+
+void Manager::wait()
+{
+    if (!impl_->stepInFlight) {
+        return;
+    }
+
+    impl_->waitAsync();
+    impl_->stepInFlight = false;
+    impl_->postStep();
+}
+
+std::string Manager::profileReport() const
+{
+    if (!impl_->cfg.enableProfiling) {
+        FATAL("Manager::profileReport requires Config::enableProfiling");
+    }
+
+    if (impl_->stepInFlight) {
+        FATAL("Manager::profileReport called while an async step is in flight");
+    }
+
+    return impl_->profileReport();
+}
+
+void Manager::resetProfile()
+{
+    if (impl_->stepInFlight) {
+        FATAL("Manager::resetProfile called while an async step is in flight");
+    }
+
+    impl_->resetProfile();
+}
+
+std::string Manager::memoryReport() const
+{
+    const Config &cfg = impl_->cfg;
+
+    std::string report;
+    char line[256];
+
+    auto append = [&](const char *fmt, auto... args) {
+        snprintf(line, sizeof(line), fmt, args...);
+        report += line;
+    };
+
+    report += "Per world (entity counts are upper bounds):\n";
+    append("%-32s %10s %12s %12s\n",
+           "archetype / component", "entities", "bytes / ent", "bytes");
+
+    uint64_t world_table_bytes = 0;
+    for (const ArchetypeLayout &archetype : archetypeLayouts()) {
+        uint64_t entity_bytes = 0;
+        for (const auto &[name, num_bytes] : archetype.components) {
+            entity_bytes += num_bytes;
+        }
+
+        uint64_t archetype_bytes = entity_bytes * archetype.maxEntities;
+        world_table_bytes += archetype_bytes;
+
+        append("%-32s %10lld %12llu %12llu\n", archetype.name,
+               (long long)archetype.maxEntities,
+               (unsigned long long)entity_bytes,
+               (unsigned long long)archetype_bytes);
+
+        for (const auto &[name, num_bytes] : archetype.components) {
+            append("  %-30s %10s %12llu %12llu\n", name, "",
+                   (unsigned long long)num_bytes,
+                   (unsigned long long)(num_bytes * archetype.maxEntities));
+        }
+    }
+
+    append("%-32s %36llu\n", "ECS tables (listed components)",
+           (unsigned long long)world_table_bytes);
+
+    // The exported tensors are the ECS columns counted above. Only the copy
+    // the CPU backend stages them into takes additional memory.
+    uint64_t world_staged_bytes = 0;
+    if (cfg.doubleBufferExports || cfg.sharedMemoryName != nullptr) {
+        for (CountT i = 0; i < (CountT)ExportID::NumExports; i++) {
+            uint64_t num_bytes = exportBytesPerWorld((ExportID)i);
+            world_staged_bytes += num_bytes;
+
+            append("  staged %-23s %36llu\n", exportName((ExportID)i),
+                   (unsigned long long)num_bytes);
+        }
+    }
+
+    append("%-32s %36llu\n", "Staged exports",
+           (unsigned long long)world_staged_bytes);
+    append("%-32s %36llu\n", "Snapshot staging",
+           (unsigned long long)(sizeof(WorldSnapshot) + sizeof(int32_t)));
+
+    uint64_t num_live_snapshots = 0;
+    for (WorldSnapshot *snapshot : impl_->snapshots) {
+        num_live_snapshots += snapshot != nullptr;
+    }
+
+    append("%-32s %36llu\n", "Snapshots",
+           (unsigned long long)(num_live_snapshots * sizeof(WorldSnapshot)));
+
+    const MemoryStats &stats = impl_->memoryStats;
+
+    append("\nMeasured while creating the executor (%s memory):\n",
+           cfg.execMode == ExecMode::CUDA ? "device" : "resident");
+    append("%-32s %36llu\n", "Total",
+           (unsigned long long)stats.executorBytes);
+    append("%-32s %36llu\n", "Per world",
+           (unsigned long long)(stats.executorBytes / cfg.numWorlds));
+    append("This covers the ECS tables, exports and the physics / BVH\n"
+           "state sized for %lld entities per world, plus fixed executor "
+           "overhead.\n", (long long)consts::maxTotalEntities);
+
+    report += "\nGlobal:\n";
+    append("%-32s %36llu\n", "PhysicsLoader rigid body assets",
+           (unsigned long long)stats.assetBytes);
+
+    return report;
+}
+
+uint32_t Manager::snapshot()
+{
+    if (impl_->stepInFlight) {
+        FATAL("Manager::snapshot called while an async step is in flight");
+    }
+
+    uint64_t num_bytes = sizeof(WorldSnapshot) * impl_->cfg.numWorlds;
+
+    impl_->runGraph(TaskGraphID::Snapshot);
+
+    // Reuse the slot of a released snapshot if there is one
+    uint32_t handle = 0;
+    while (handle < (uint32_t)impl_->snapshots.size() &&
+           impl_->snapshots[handle] != nullptr) {
+        handle++;
+    }
+
+    if (handle == (uint32_t)impl_->snapshots.size()) {
+        impl_->snapshots.push_back(nullptr);
+    }
+
+    auto snapshot = (WorldSnapshot *)allocSimBuffer(
+        impl_->cfg.execMode, num_bytes);
+    impl_->copyFromSim(snapshot, impl_->snapshotStaging, num_bytes);
+    impl_->snapshots[handle] = snapshot;
+
+    return handle;
+}
+
+void Manager::restore(uint32_t handle)
+{
+    if (impl_->stepInFlight) {
+        FATAL("Manager::restore called while an async step is in flight");
+    }
+
+    if (handle >= (uint32_t)impl_->snapshots.size() ||
+            impl_->snapshots[handle] == nullptr) {
+        FATAL("Manager::restore: invalid snapshot handle %u", handle);
+    }
+
+    const Config &cfg = impl_->cfg;
+
+    impl_->copyFromSim(impl_->snapshotStaging, impl_->snapshots[handle],
+                       sizeof(WorldSnapshot) * cfg.numWorlds);
+
+    HeapArray<int32_t> restore_all(cfg.numWorlds);
+    for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
+        restore_all[i] = 1;
+    }
+
+    impl_->copyToSim(impl_->snapshotRestoreMask, restore_all.data(),
+                     sizeof(int32_t) * cfg.numWorlds);
+
+    impl_->runGraph(TaskGraphID::Restore);
+    impl_->postStep();
+}
+
+void Manager::cloneWorld(int32_t src_world, Span<const int32_t> dst_mask)
+{
+    const Config &cfg = impl_->cfg;
+
+    if (src_world < 0 || src_world >= (int32_t)cfg.numWorlds) {
+        FATAL("cloneWorld: invalid source world %d", src_world);
+    }
+
+    if (dst_mask.size() != (CountT)cfg.numWorlds) {
+        FATAL("cloneWorld: expected a mask of %u worlds, got %lld",
+              cfg.numWorlds, (long long)dst_mask.size());
+    }
+
+    if (impl_->stepInFlight) {
+        FATAL("Manager::cloneWorld called while an async step is in flight");
+    }
+
+    impl_->runGraph(TaskGraphID::Snapshot);
+
+    // Hand the source world's snapshot to every destination world
+    HeapArray<int32_t> restore_mask(cfg.numWorlds);
+    for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
+        restore_mask[i] = dst_mask[i] != 0 && i != src_world;
+
+        if (restore_mask[i]) {
+            impl_->copyFromSim(&impl_->snapshotStaging[i],
+                               &impl_->snapshotStaging[src_world],
+                               sizeof(WorldSnapshot));
+        }
+    }
+
+    impl_->copyToSim(impl_->snapshotRestoreMask, restore_mask.data(),
+                     sizeof(int32_t) * cfg.numWorlds);
+
+    impl_->runGraph(TaskGraphID::Restore);
+    impl_->postStep();
+}
+
+void Manager::releaseSnapshot(uint32_t handle)
+{
+    if (handle >= (uint32_t)impl_->snapshots.size() ||
+            impl_->snapshots[handle] == nullptr) {
+        FATAL("Manager::releaseSnapshot: invalid snapshot handle %u", handle);
+    }
+
+    freeSimBuffer(impl_->cfg.execMode, impl_->snapshots[handle]);
+    impl_->snapshots[handle] = nullptr;
+}
+
+void Manager::stepN(int32_t num_steps,
+                    Span<const Action> actions,
+                    const TrajectoryBuffers &out)
+{
+    CountT num_step_actions =
+        (CountT)impl_->cfg.numWorlds * consts::numAgents;
+
+    if (actions.size() != num_steps * num_step_actions) {
+        FATAL("stepN: expected %lld actions for %d steps, got %lld",
+              (long long)(num_steps * num_step_actions), num_steps,
+              (long long)actions.size());
+    }
+
+    const std::array<std::pair<ExportID, void *>, 11> outputs {{
+        { ExportID::Reward, out.rewards },
+        { ExportID::Done, out.dones },
+        { ExportID::SelfObservation, out.selfObservations },
+        { ExportID::PartnerObservations, out.partnerObservations },
+        { ExportID::RoomEntityObservations, out.roomEntityObservations },
+        { ExportID::DoorObservation, out.doorObservations },
+        { ExportID::Lidar, out.lidars },
+        { ExportID::StepsRemaining, out.stepsRemaining },
+        { ExportID::FlatObservation, out.flatObservations },
+        { ExportID::HalfObservation, out.halfObservations },
+        { ExportID::CompactLidar, out.compactLidars },
+    }};
+
+    for (int32_t i = 0; i < num_steps; i++) {
+        setActions(Span<const Action>(
+            actions.data() + i * num_step_actions, num_step_actions));
+        step();
+
+        for (const auto &[slot, dst_base] : outputs) {
+            if (dst_base == nullptr || !isExportEnabled(impl_->cfg, slot)) {
+                continue;
+            }
+
+            uint64_t num_step_bytes =
+                impl_->cfg.numWorlds * exportBytesPerWorld(slot);
+
+            impl_->copyFromSim((char *)dst_base + i * num_step_bytes,
+                               impl_->exportPtr(slot), num_step_bytes);
+        }
     }
 }
 
@@ -551,6 +1971,16 @@ Tensor Manager::resetTensor() const
                                });
 }
 
+Tensor Manager::activeTensor() const
+{
+    return impl_->exportTensor(ExportID::Active,
+                               TensorElementType::Int32,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   1,
+                               });
+}
+
 Tensor Manager::actionTensor() const
 {
     return impl_->exportTensor(ExportID::Action, TensorElementType::Int32,
@@ -638,6 +2068,18 @@ Tensor Manager::lidarTensor() const
                                });
 }
 
+Tensor Manager::compactLidarTensor() const
+{
+    return impl_->exportTensor(ExportID::CompactLidar,
+                               TensorElementType::UInt8,
+                               {
+                                   impl_->cfg.numWorlds,
+                                   consts::numAgents,
+                                   consts::numLidarSamples,
+                                   2,
+                               });
+}
+
 Tensor Manager::stepsRemainingTensor() const
 {
     return impl_->exportTensor(ExportID::StepsRemaining,
@@ -649,6 +2091,29 @@ Tensor Manager::stepsRemainingTensor() const
                                });
 }
 
+Tensor Manager::flatObservationTensor() const
+{
+    return impl_->exportTensor(ExportID::FlatObservation,
+                               TensorElementType::Float32,
+                               {
+                                   impl_->cfg.numWorlds * consts::numAgents,
+                                   numFlatObsFeatures,
+                               });
+}
+
+Tensor Manager::halfObservationTensor() const
+{
+    TensorElementType type =
+        impl_->cfg.obsPrecision == ObservationPrecision::BFloat16 ?
+            TensorElementType::Int16 : TensorElementType::Float16;
+
+    return impl_->exportTensor(ExportID::HalfObservation, type,
+                               {
+                                   impl_->cfg.numWorlds * consts::numAgents,
+                                   numFlatObsFeatures,
+                               });
+}
+
 Tensor Manager::rgbTensor() const
 {
     const uint8_t *rgb_ptr = impl_->renderMgr->batchRendererRGBOut();
@@ -693,6 +2158,69 @@ void Manager::triggerReset(int32_t world_idx)
     }
 }
 
+void Manager::resetWorlds(Span<const int32_t> mask)
+{
+    CountT num_worlds = impl_->cfg.numWorlds;
+    if (mask.size() != num_worlds) {
+        FATAL("resetWorlds: expected a mask of %lld worlds, got %lld",
+              (long long)num_worlds, (long long)mask.size());
+    }
+
+    if (impl_->cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        // Merge with resets that are already pending so worlds outside the
+        // mask keep them, at the cost of one round trip rather than one
+        // copy per world.
+        HeapArray<WorldReset> resets(num_worlds);
+        cudaMemcpy(resets.data(), impl_->worldResetBuffer,
+                   sizeof(WorldReset) * num_worlds, cudaMemcpyDeviceToHost);
+
+        for (CountT i = 0; i < num_worlds; i++) {
+            if (mask[i] != 0) {
+                resets[i].reset = 1;
+            }
+        }
+
+        cudaMemcpy(impl_->worldResetBuffer, resets.data(),
+                   sizeof(WorldReset) * num_worlds, cudaMemcpyHostToDevice);
+#endif
+    } else {
+        WorldReset *resets = impl_->worldResetBuffer;
+        for (CountT i = 0; i < num_worlds; i++) {
+            if (mask[i] != 0) {
+                resets[i].reset = 1;
+            }
+        }
+    }
+}
+
+void Manager::resetAll()
+{
+    CountT num_worlds = impl_->cfg.numWorlds;
+
+    HeapArray<WorldReset> resets(num_worlds);
+    for (CountT i = 0; i < num_worlds; i++) {
+        resets[i].reset = 1;
+    }
+
+    impl_->copyToSim(impl_->worldResetBuffer, resets.data(),
+                     sizeof(WorldReset) * num_worlds);
+}
+
+void Manager::setWorldActive(int32_t world_idx, bool active)
+{
+    if (world_idx < 0 || world_idx >= (int32_t)impl_->cfg.numWorlds) {
+        FATAL("setWorldActive: invalid world %d", world_idx);
+    }
+
+    WorldActive world_active {
+        active ? 1 : 0,
+    };
+
+    impl_->copyToSim(impl_->worldActiveBuffer + world_idx,
+                     &world_active, sizeof(WorldActive));
+}
+
 void Manager::setAction(int32_t world_idx,
                         int32_t agent_idx,
                         int32_t move_amount,
@@ -720,6 +2248,111 @@ void Manager::setAction(int32_t world_idx,
     }
 }
 
+void Manager::worldStateHashes(Span<uint64_t> hashes) const
+{
+    const Config &cfg = impl_->cfg;
+
+    if (hashes.size() != (CountT)cfg.numWorlds) {
+        FATAL("worldStateHashes: expected %u hashes, got %lld",
+              cfg.numWorlds, (long long)hashes.size());
+    }
+
+    if (impl_->stepInFlight) {
+        FATAL("Manager::worldStateHashes called while an async step is "
+              "in flight");
+    }
+
+    for (CountT i = 0; i < hashes.size(); i++) {
+        hashes[i] = 0xcbf29ce484222325ull;
+    }
+
+    uint64_t max_world_bytes = 0;
+    for (CountT slot_idx = 0; slot_idx < (CountT)ExportID::NumExports;
+         slot_idx++) {
+        max_world_bytes = std::max(max_world_bytes,
+                                   exportBytesPerWorld((ExportID)slot_idx));
+    }
+
+    // Staging for device exports on the CUDA backend
+    HeapArray<char> host_copy(cfg.execMode == ExecMode::CUDA ?
+        max_world_bytes * cfg.numWorlds : 0);
+
+    // Every export is laid out as [world][...], hash each world's slice
+    for (CountT slot_idx = 0; slot_idx < (CountT)ExportID::NumExports;
+         slot_idx++) {
+        ExportID slot = (ExportID)slot_idx;
+        uint64_t num_world_bytes = exportBytesPerWorld(slot);
+
+        const char *export_data = (const char *)impl_->exportPtr(slot);
+        if (cfg.execMode == ExecMode::CUDA) {
+            impl_->copyFromSim(host_copy.data(), export_data,
+                               num_world_bytes * cfg.numWorlds);
+            export_data = host_copy.data();
+        }
+
+        for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
+            hashes[i] = hashBytes(export_data + i * num_world_bytes,
+                                  num_world_bytes, hashes[i]);
+        }
+    }
+}
+
+void Manager::setActions(Span<const Action> actions)
+{
+    CountT num_actions = (CountT)impl_->cfg.numWorlds * consts::numAgents;
+    if (actions.size() != num_actions) {
+        FATAL("setActions: expected %lld actions, got %lld",
+              (long long)num_actions, (long long)actions.size());
+    }
+
+    if (impl_->cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        cudaMemcpy(impl_->agentActionsBuffer, actions.data(),
+                   sizeof(Action) * num_actions, cudaMemcpyHostToDevice);
+#endif
+    } else {
+        memcpy(impl_->agentActionsBuffer, actions.data(),
+               sizeof(Action) * num_actions);
+    }
+}
+
+void Manager::setActionsStrided(const int32_t *actions,
+                                int64_t world_stride,
+                                int64_t agent_stride,
+                                int64_t field_stride)
+{
+    CountT num_worlds = impl_->cfg.numWorlds;
+
+    auto packActions = [&](Action *out) {
+        for (CountT i = 0; i < num_worlds; i++) {
+            for (CountT j = 0; j < consts::numAgents; j++) {
+                const int32_t *src =
+                    actions + i * world_stride + j * agent_stride;
+
+                out[i * consts::numAgents + j] = Action {
+                    .moveAmount = src[0],
+                    .moveAngle = src[field_stride],
+                    .rotate = src[2 * field_stride],
+                    .grab = src[3 * field_stride],
+                };
+            }
+        }
+    };
+
+    if (impl_->cfg.execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+        // Pack on the host so the upload is still a single copy
+        HeapArray<Action> staging(num_worlds * consts::numAgents);
+        packActions(staging.data());
+
+        cudaMemcpy(impl_->agentActionsBuffer, staging.data(),
+                   sizeof(Action) * staging.size(), cudaMemcpyHostToDevice);
+#endif
+    } else {
+        packActions(impl_->agentActionsBuffer);
+    }
+}
+
 render::RenderManager & Manager::getRenderManager()
 {
     return *impl_->renderMgr;
@@ -1,12 +1,17 @@
 #include <memory>
+#include <string>
 
 #include <madrona/py/utils.hpp>
 #include <madrona/exec_mode.hpp>
 
 #include <madrona/render/render_mgr.hpp>
 
+#include "half.hpp"
+
 namespace madEscape {
 
+struct Action;
+
 // The Manager class encapsulates the linkage between the outside training
 // code and the internal simulation state (src/sim.hpp / src/sim.cpp)
 //
@@ -26,6 +31,81 @@ public:
         uint32_t batchRenderViewHeight = 64;
         madrona::render::APIBackend *extRenderAPI = nullptr;
         madrona::render::GPUDevice *extRenderDev = nullptr;
+        // CPU only: back the exported tensors with manager-owned copies
+        // that are only updated when a step completes. Required by
+        // stepAsync(), so tensors can be accessed while a step is in flight.
+        bool doubleBufferExports = false;
+        // CPU only: when set, the exported buffers (double buffered as
+        // above) live in a named POSIX shared memory region described by a
+        // SharedExportHeader (src/shared_exports.hpp), so other processes
+        // can map observations and write actions without copies. The name
+        // must not exist yet. Only read during construction.
+        const char *sharedMemoryName = nullptr;
+        // CPU only: number of executor worker threads. 0 picks one per
+        // available CPU (or per pinned CPU when pinning is requested).
+        uint32_t numWorkers = 0;
+        // CPU only (Linux): pin the executor's worker threads to the CPUs
+        // of this NUMA node and prefer the node for memory allocated while
+        // the worlds are initialized, so ECS tables are node local. -1
+        // disables. To partition worlds across sockets, run one Manager
+        // (e.g. one process) per node with its share of the worlds.
+        int32_t numaNode = -1;
+        // CPU only (Linux): explicit CPU list for the worker threads, used
+        // when numaNode is -1.
+        const int32_t *pinnedCPUs = nullptr;
+        uint32_t numPinnedCPUs = 0;
+        // CPU only: time every section of the step task graphs in each
+        // world, see profileReport().
+        bool enableProfiling = false;
+        // CPU only: when set, write a Chrome trace event JSON file to this
+        // path with a span for every step graph section in every world (on
+        // the worker thread that ran it), plus the Manager's own work.
+        const char *tracePath = nullptr;
+        // When set, the processed collision assets are cached in this
+        // directory, keyed by a hash of the madrona revision, the source
+        // meshes and collision parameters, and memory mapped by later runs
+        // instead of being rebuilt. The directory is created if needed.
+        const char *assetCacheDir = nullptr;
+        // Have the observation systems also fill flatObservationTensor()
+        // every step. The separate observation tensors stay valid.
+        // The columns behind this and the other optional exports below are
+        // allocated for every agent regardless, but disabled ones are not
+        // written or copied each step.
+        bool flatObservations = false;
+        // When Float16 or BFloat16, the observation systems also fill
+        // halfObservationTensor() every step, in the flat layout.
+        ObservationPrecision obsPrecision = ObservationPrecision::Float32;
+        // Have lidarSystem also fill compactLidarTensor() every step
+        bool compactLidar = false;
+        // Lidar rays traced per agent, between 1 and consts::numLidarSamples,
+        // spread over lidarSpan radians centered on the agent's forward
+        // direction (2 pi, the default, is a full circle), and their range.
+        uint32_t numLidarSamples = 30;
+        float lidarSpan = 6.2831853f;
+        float lidarMaxRange = 200.f;
+        // Reuse each world's previous lidar samples in steps where no body
+        // the rays can hit (agents included) moved. Samples can be up to
+        // twice consts::lidarCachePosEpsilon / lidarCacheRotEpsilon stale.
+        bool lidarCaching = false;
+    };
+
+    // Caller provided output buffers for stepN. Each non-null pointer must
+    // have room for num_steps consecutive copies of the matching exported
+    // tensor, i.e. [num_steps, numWorlds * numAgents, ...]. On the CUDA
+    // backend these may be either host or device pointers. Buffers for
+    // optional exports that are disabled in the Config are left untouched.
+    struct TrajectoryBuffers {
+        void *rewards = nullptr;
+        void *dones = nullptr;
+        void *selfObservations = nullptr;
+        void *partnerObservations = nullptr;
+        void *roomEntityObservations = nullptr;
+        void *doorObservations = nullptr;
+        void *lidars = nullptr;
+        void *stepsRemaining = nullptr;
+        void *flatObservations = nullptr;
+        void *halfObservations = nullptr;
+        void *compactLidars = nullptr;
     };
 
     Manager(const Config &cfg);
@@ -33,9 +113,68 @@ public:
 
     void step();
 
+    // Split version of step(). On the CPU backend, stepAsync() launches the
+    // task graph on the executor's worker threads and returns immediately;
+    // wait() blocks until it has finished. The CPU backend requires
+    // Config::doubleBufferExports (or sharedMemoryName), so the caller may
+    // read the previous step's outputs and write the next step's actions /
+    // resets while the step is running.
+    // The CUDA backend runs the step synchronously inside stepAsync().
+    void stepAsync();
+    void wait();
+
+    // Runs num_steps steps back to back with an open loop action schedule.
+    // actions holds num_steps * numWorlds * numAgents entries laid out as
+    // [step][world][agent]. After each step the requested outputs are
+    // copied into the matching slice of out.
+    void stepN(int32_t num_steps,
+               madrona::Span<const Action> actions,
+               const TrajectoryBuffers &out);
+
+    // Human readable table of the time spent in each section of the step
+    // task graphs, summed over all worlds, along with the wall time per
+    // step. Requires Config::enableProfiling. resetProfile() clears the
+    // accumulated timings, for instance after warmup steps. Neither may be
+    // called while an async step is in flight.
+    std::string profileReport() const;
+    void resetProfile();
+
+    // Human readable breakdown of memory use: bytes per world by archetype
+    // and component, staged export copies and snapshots, the memory measured
+    // while the executor created the worlds (including physics / BVH
+    // state), and global collision asset memory.
+    std::string memoryReport() const;
+
+    // In-memory world snapshots. snapshot() captures the state of every
+    // world (agents, level entities, doors, grabs, RNG and episode counter)
+    // and returns a handle. restore() rewinds all worlds to a snapshot and
+    // recomputes the observations without taking a step, paused worlds
+    // included; the same snapshot can be restored any number of times until
+    // releaseSnapshot().
+    uint32_t snapshot();
+    void restore(uint32_t handle);
+    void releaseSnapshot(uint32_t handle);
+
+    // Copies the state of world src_world, as captured by snapshot(), into
+    // every world whose entry in the numWorlds long dst_mask is non-zero,
+    // regenerating src_world's level in them. The destination worlds
+    // continue from there with their own episode sequence once the cloned
+    // episode ends. Their observations are recomputed even if they are
+    // paused.
+    void cloneWorld(int32_t src_world,
+                    madrona::Span<const int32_t> dst_mask);
+
+    // Writes a checksum of each world's slice of every exported tensor
+    // (inputs, observations, rewards, dones, ...) into hashes, which must
+    // hold numWorlds entries. Used to check that two runs of the same
+    // action sequence stay bit identical.
+    void worldStateHashes(madrona::Span<uint64_t> hashes) const;
+
     // These functions export Tensor objects that link the ECS
     // simulation state to the python bindings / PyTorch tensors (src/bindings.cpp)
     madrona::py::Tensor resetTensor() const;
+    // [numWorlds, 1] int32 mask, worlds with 0 are paused (see WorldActive)
+    madrona::py::Tensor activeTensor() const;
     madrona::py::Tensor actionTensor() const;
     madrona::py::Tensor rewardTensor() const;
     madrona::py::Tensor doneTensor() const;
@@ -43,14 +182,36 @@ public:
     madrona::py::Tensor partnerObservationsTensor() const;
     madrona::py::Tensor roomEntityObservationsTensor() const;
     madrona::py::Tensor doorObservationTensor() const;
+    // [numWorlds, numAgents, consts::numLidarSamples, 2]. Only the first
+    // Config::numLidarSamples samples of each agent are traced, the rest
+    // stay zero. Slice them off on the consumer side, each agent's row
+    // keeps its full size in the ECS column.
     madrona::py::Tensor lidarTensor() const;
+    // Same shape in uint8, see CompactLidar (src/types.hpp). Only written
+    // with Config::compactLidar.
+    madrona::py::Tensor compactLidarTensor() const;
     madrona::py::Tensor stepsRemainingTensor() const;
+    // [numWorlds * numAgents, numFlatObsFeatures] float32, see
+    // FlatObservation (src/types.hpp) for the feature layout. Only written
+    // with Config::flatObservations.
+    madrona::py::Tensor flatObservationTensor() const;
+    // [numWorlds * numAgents, numFlatObsFeatures] in the flat layout, at
+    // Config::obsPrecision. Float16 for fp16. bf16 has no TensorElementType,
+    // so it is exported as Int16 holding the raw bits (view as bfloat16).
+    madrona::py::Tensor halfObservationTensor() const;
     madrona::py::Tensor rgbTensor() const;
     madrona::py::Tensor depthTensor() const;
 
     // These functions are used by the viewer to control the simulation
     // with keyboard inputs in place of DNN policy actions
     void triggerReset(int32_t world_idx);
+
+    // Bulk versions of triggerReset. resetWorlds resets every world whose
+    // entry in the numWorlds long mask is non-zero, resetAll resets all.
+    void resetWorlds(madrona::Span<const int32_t> mask);
+    void resetAll();
+
+    void setWorldActive(int32_t world_idx, bool active);
     void setAction(int32_t world_idx,
                    int32_t agent_idx,
                    int32_t move_amount,
@@ -58,9 +219,24 @@ public:
                    int32_t rotate,
                    int32_t grab);
 
+    // Bulk version of setAction: writes the actions for every agent in all
+    // worlds in a single pass. actions must hold numWorlds * numAgents
+    // entries laid out as [world][agent].
+    void setActions(madrona::Span<const Action> actions);
+
+    // Same as setActions, but reads the 4 action fields out of an arbitrarily
+    // strided [numWorlds, numAgents, 4] int32 buffer (for example a
+    // non-contiguous numpy / torch view). Strides are in int32_t elements.
+    void setActionsStrided(const int32_t *actions,
+                           int64_t world_stride,
+                           int64_t agent_stride,
+                           int64_t field_stride);
+
     madrona::render::RenderManager & getRenderManager();
 
 private:
+    void describeSharedExports();
+
     struct Impl;
     struct CPUImpl;
     struct CUDAImpl;
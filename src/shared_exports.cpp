@@ -0,0 +1,77 @@
+#include "shared_exports.hpp"
+
+#include <madrona/crash.hpp>
+#include <madrona/macros.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(MADRONA_LINUX) || defined(MADRONA_MACOS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace madEscape {
+
+#if defined(MADRONA_LINUX) || defined(MADRONA_MACOS)
+
+SharedExportRegion::SharedExportRegion(const char *name,
+                                       uint64_t num_buffer_bytes)
+    : name_(name),
+      mapping_(nullptr),
+      numMappedBytes_(buffersOffset() + num_buffer_bytes)
+{
+    // Never reuse an existing region: truncating it would shrink the mapping
+    // under whichever process still has it mapped.
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1 && errno == EEXIST) {
+        FATAL("Shared memory region %s already exists. Pick another name, "
+              "or shm_unlink it if a crashed process left it behind", name);
+    } else if (fd == -1) {
+        FATAL("Failed to create shared memory region %s: %s",
+              name, strerror(errno));
+    }
+
+    if (ftruncate(fd, (off_t)numMappedBytes_) != 0) {
+        FATAL("Failed to size shared memory region %s: %s",
+              name, strerror(errno));
+    }
+
+    mapping_ = mmap(nullptr, numMappedBytes_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping_ == MAP_FAILED) {
+        FATAL("Failed to map shared memory region %s: %s",
+              name, strerror(errno));
+    }
+
+    memset(mapping_, 0, numMappedBytes_);
+
+    SharedExportHeader *hdr = header();
+    hdr->magic = sharedExportMagic;
+    hdr->version = sharedExportVersion;
+}
+
+SharedExportRegion::~SharedExportRegion()
+{
+    munmap(mapping_, numMappedBytes_);
+    shm_unlink(name_.c_str());
+}
+
+#else
+
+SharedExportRegion::SharedExportRegion(const char *, uint64_t)
+    : name_(),
+      mapping_(nullptr),
+      numMappedBytes_(0)
+{
+    FATAL("Shared memory exports require a POSIX platform");
+}
+
+SharedExportRegion::~SharedExportRegion() {}
+
+#endif
+
+}
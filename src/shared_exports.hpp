@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace madEscape {
+
+// Layout of the named POSIX shared memory region the Manager creates when
+// Manager::Config::sharedMemoryName is set. The region starts with a
+// SharedExportHeader, followed by one buffer per exported tensor at the
+// offsets listed in the header. Each buffer has exactly the layout of the
+// tensor returned by the matching Manager::*Tensor() function, so separate
+// processes can map the region with shm_open + mmap and read observations
+// (or write actions) without any copies. The Manager consumes each world's
+// reset flag with an atomic exchange, so writers should set it with an
+// atomic store.
+inline constexpr uint32_t sharedExportMagic = 0x5845454d; // "MEEX"
+inline constexpr uint32_t sharedExportVersion = 1;
+inline constexpr uint32_t sharedExportMaxExports = 32;
+inline constexpr uint32_t sharedExportMaxDims = 4;
+
+struct SharedExportDesc {
+    // Byte offset of the buffer from the start of the region
+    uint64_t offset;
+    uint64_t numBytes;
+    // Value of madrona::py::TensorElementType
+    uint32_t elementType;
+    uint32_t numDims;
+    int64_t dims[sharedExportMaxDims];
+};
+
+struct SharedExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numWorlds;
+    uint32_t numAgents;
+    uint32_t numExports;
+    uint32_t pad;
+
+    // Sequence counter for the output buffers. It is odd while the Manager
+    // is copying out the results of a step and even once they are complete,
+    // so readers can detect torn reads by checking it before and after.
+    uint64_t stepSequence;
+
+    // Indexed by ExportID
+    SharedExportDesc exports[sharedExportMaxExports];
+};
+
+// Owns the shared memory region for the lifetime of the Manager. The name is
+// unlinked on destruction, processes that still have it mapped keep access.
+class SharedExportRegion {
+public:
+    SharedExportRegion(const char *name, uint64_t num_buffer_bytes);
+    ~SharedExportRegion();
+
+    SharedExportRegion(const SharedExportRegion &) = delete;
+    SharedExportRegion & operator=(const SharedExportRegion &) = delete;
+
+    inline SharedExportHeader * header() const
+    {
+        return (SharedExportHeader *)mapping_;
+    }
+
+    inline char * buffers() const
+    {
+        return (char *)mapping_ + buffersOffset();
+    }
+
+    // Export buffers start on a cache line after the header
+    static inline constexpr uint64_t buffersOffset()
+    {
+        return (sizeof(SharedExportHeader) + 63) & ~uint64_t(63);
+    }
+
+private:
+    std::string name_;
+    void *mapping_;
+    uint64_t numMappedBytes_;
+};
+
+}
@@ -5,6 +5,11 @@
 
 #include <algorithm>
 
+#ifndef MADRONA_GPU_MODE
+#include <atomic>
+#include <chrono>
+#endif
+
 using namespace madrona;
 using namespace madrona::math;
 using namespace madrona::phys;
@@ -36,10 +41,15 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
     registry.registerComponent<OpenState>();
     registry.registerComponent<DoorProperties>();
     registry.registerComponent<Lidar>();
+    registry.registerComponent<CompactLidar>();
     registry.registerComponent<StepsRemaining>();
+    registry.registerComponent<FlatObservation>();
+    registry.registerComponent<HalfObservation>();
     registry.registerComponent<EntityType>();
+    registry.registerComponent<LastPose>();
 
     registry.registerSingleton<WorldReset>();
+    registry.registerSingleton<WorldActive>();
     registry.registerSingleton<LevelState>();
 
     registry.registerArchetype<Agent>();
@@ -49,6 +59,8 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
 
     registry.exportSingleton<WorldReset>(
         (uint32_t)ExportID::Reset);
+    registry.exportSingleton<WorldActive>(
+        (uint32_t)ExportID::Active);
     registry.exportColumn<Agent, Action>(
         (uint32_t)ExportID::Action);
     registry.exportColumn<Agent, SelfObservation>(
@@ -63,6 +75,12 @@ void Sim::registerTypes(ECSRegistry &registry, const Config &cfg)
         (uint32_t)ExportID::Lidar);
     registry.exportColumn<Agent, StepsRemaining>(
         (uint32_t)ExportID::StepsRemaining);
+    registry.exportColumn<Agent, FlatObservation>(
+        (uint32_t)ExportID::FlatObservation);
+    registry.exportColumn<Agent, HalfObservation>(
+        (uint32_t)ExportID::HalfObservation);
+    registry.exportColumn<Agent, CompactLidar>(
+        (uint32_t)ExportID::CompactLidar);
     registry.exportColumn<Agent, Reward>(
         (uint32_t)ExportID::Reward);
     registry.exportColumn<Agent, Done>(
@@ -87,18 +105,54 @@ static inline void cleanupWorld(Engine &ctx)
     }
 }
 
-static inline void initWorld(Engine &ctx)
+// Generates the level of episode episode_idx in level_world_idx's sequence
+// of episodes. Worlds normally generate their own sequence, restoring a
+// snapshot cloned from another world regenerates that world's level.
+static inline void generateEpisode(Engine &ctx,
+                                   uint32_t episode_idx,
+                                   uint32_t level_world_idx)
 {
     phys::PhysicsSystem::reset(ctx);
 
-    // Assign a new episode ID
+    ctx.data().lidarCacheInvalid = true;
+    ctx.data().curWorldEpisode = episode_idx + 1;
+    ctx.data().levelWorldIdx = level_world_idx;
     ctx.data().rng = RNG(rand::split_i(ctx.data().initRandKey,
-        ctx.data().curWorldEpisode++, (uint32_t)ctx.worldID().idx));
+        episode_idx, level_world_idx));
 
     // Defined in src/level_gen.hpp / src/level_gen.cpp
     generateWorld(ctx);
 }
 
+static inline void initWorld(Engine &ctx)
+{
+    // Assign a new episode ID
+    generateEpisode(ctx, ctx.data().curWorldEpisode,
+                    (uint32_t)ctx.worldID().idx);
+}
+
+// Worlds paused through the WorldActive singleton skip all per-step work
+// that this simulator controls. The physics tasks still execute, so
+// pausedWorldVelocitySystem zeroes their velocities around the physics step.
+static inline bool isWorldActive(Engine &ctx)
+{
+    return ctx.singleton<WorldActive>().active != 0;
+}
+
+// The observation systems also run in paused worlds whose state was just
+// created or restored, so their observations match the new state.
+static inline bool shouldCollectObservations(Engine &ctx)
+{
+    return isWorldActive(ctx) || ctx.data().refreshObservations;
+}
+
+// Ends the refresh requested through Sim::refreshObservations, runs after
+// the observation tasks of the Init and Restore graphs.
+inline void finishObservationRefreshSystem(Engine &ctx, WorldReset &)
+{
+    ctx.data().refreshObservations = false;
+}
+
 // This system runs each frame and checks if the current episode is complete
 // or if code external to the application has forced a reset by writing to the
 // WorldReset singleton.
@@ -106,6 +160,10 @@ static inline void initWorld(Engine &ctx)
 // If a reset is needed, cleanup the existing world and generate a new one.
 inline void resetSystem(Engine &ctx, WorldReset &reset)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     int32_t should_reset = reset.reset;
     if (ctx.data().autoReset) {
         for (CountT i = 0; i < consts::numAgents; i++) {
@@ -127,12 +185,18 @@ inline void resetSystem(Engine &ctx, WorldReset &reset)
 
 // Translates discrete actions from the Action component to forces
 // used by the physics simulation.
-inline void movementSystem(Engine &,
+inline void movementSystem(Engine &ctx,
                            Action &action, 
                            Rotation &rot, 
                            ExternalForce &external_force,
                            ExternalTorque &external_torque)
 {
+    if (!isWorldActive(ctx)) {
+        external_force = Vector3::zero();
+        external_torque = Vector3::zero();
+        return;
+    }
+
     constexpr float move_max = 1000;
     constexpr float turn_max = 320;
 
@@ -167,7 +231,7 @@ inline void grabSystem(Engine &ctx,
                        Action action,
                        GrabState &grab)
 {
-    if (action.grab == 0) {
+    if (action.grab == 0 || !isWorldActive(ctx)) {
         return;
     }
 
@@ -221,13 +285,21 @@ inline void grabSystem(Engine &ctx,
 
     grab.constraintEntity = PhysicsSystem::makeFixedJoint(ctx,
         e, grab_entity, attach1, attach2, r1, r2, separation);
+    grab.grabbedEntity = grab_entity;
+    grab.attachRot = attach2;
+    grab.attachPos = r2;
+    grab.separation = separation;
 }
 
 // Animates the doors opening and closing based on OpenState
-inline void setDoorPositionSystem(Engine &,
+inline void setDoorPositionSystem(Engine &ctx,
                                   Position &pos,
                                   OpenState &open_state)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     if (open_state.isOpen) {
         // Put underground
         if (pos.z > -4.5f) {
@@ -251,6 +323,10 @@ inline void buttonSystem(Engine &ctx,
                          Position pos,
                          ButtonState &state)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     AABB button_aabb {
         .pMin = pos + Vector3 { 
             -consts::buttonWidth / 2.f, 
@@ -279,6 +355,10 @@ inline void doorOpenSystem(Engine &ctx,
                            OpenState &open_state,
                            const DoorProperties &props)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     bool all_pressed = true;
     for (int32_t i = 0; i < props.numButtons; i++) {
         Entity button = props.buttons[i];
@@ -305,6 +385,20 @@ inline void agentZeroVelSystem(Engine &,
     vel.angular = Vector3::zero();
 }
 
+// Freezes the bodies of paused worlds, which the physics tasks still
+// integrate. Runs before the substeps to stop bodies that were moving when
+// the world was paused, and after them to discard the velocity gravity and
+// the grab joints added, so resting bodies stay where they are.
+inline void pausedWorldVelocitySystem(Engine &ctx, Velocity &vel)
+{
+    if (isWorldActive(ctx)) {
+        return;
+    }
+
+    vel.linear = Vector3::zero();
+    vel.angular = Vector3::zero();
+}
+
 static inline float distObs(float v)
 {
     return v / consts::worldLength;
@@ -341,6 +435,12 @@ static inline float encodeType(EntityType type)
     return (float)type / (float)EntityType::NumTypes;
 }
 
+// Quantizes a distObs value to a byte, saturating past consts::worldLength
+static inline uint8_t quantizeDistObs(float v)
+{
+    return (uint8_t)(fminf(fmaxf(v, 0.f), 1.f) * 255.f + 0.5f);
+}
+
 static inline float computeZAngle(Quat q)
 {
     float siny_cosp = 2.f * (q.w * q.z + q.x * q.y);
@@ -348,6 +448,41 @@ static inline float computeZAngle(Quat q)
     return atan2f(siny_cosp, cosy_cosp);
 }
 
+// Copies an observation, which only holds floats, into its block of
+// FlatObservation and / or HalfObservation, whichever are enabled
+template <typename T>
+static inline void writeFlatObs(Engine &ctx,
+                                FlatObservation &flat_obs,
+                                HalfObservation &half_obs,
+                                CountT offset,
+                                const T &obs)
+{
+    static_assert(sizeof(T) % sizeof(float) == 0);
+    constexpr CountT num_features = sizeof(T) / sizeof(float);
+
+    const float *src = (const float *)&obs;
+
+    if (ctx.data().flatObservations) {
+        for (CountT i = 0; i < num_features; i++) {
+            flat_obs.features[offset + i] = src[i];
+        }
+    }
+
+    switch (ctx.data().obsPrecision) {
+    case ObservationPrecision::Float16: {
+        for (CountT i = 0; i < num_features; i++) {
+            half_obs.features[offset + i] = floatToHalf(src[i]);
+        }
+    } break;
+    case ObservationPrecision::BFloat16: {
+        for (CountT i = 0; i < num_features; i++) {
+            half_obs.features[offset + i] = floatToBFloat16(src[i]);
+        }
+    } break;
+    default: break;
+    }
+}
+
 // This system packages all the egocentric observations together 
 // for the policy inputs.
 inline void collectObservationsSystem(Engine &ctx,
@@ -356,11 +491,18 @@ inline void collectObservationsSystem(Engine &ctx,
                                       const Progress &progress,
                                       const GrabState &grab,
                                       const OtherAgents &other_agents,
+                                      const StepsRemaining &steps_remaining,
                                       SelfObservation &self_obs,
                                       PartnerObservations &partner_obs,
                                       RoomEntityObservations &room_ent_obs,
-                                      DoorObservation &door_obs)
+                                      DoorObservation &door_obs,
+                                      FlatObservation &flat_obs,
+                                      HalfObservation &half_obs)
 {
+    if (!shouldCollectObservations(ctx)) {
+        return;
+    }
+
     CountT cur_room_idx = CountT(pos.y / consts::roomLength);
     cur_room_idx = std::max(CountT(0), 
         std::min(consts::numRooms - 1, cur_room_idx));
@@ -421,48 +563,137 @@ inline void collectObservationsSystem(Engine &ctx,
 
     door_obs.polar = xyToPolar(to_view.rotateVec(door_pos - pos));
     door_obs.isOpen = door_open_state.isOpen ? 1.f : 0.f;
+
+    float steps_remaining_obs =
+        float(steps_remaining.t) / float(consts::episodeLen);
+
+    writeFlatObs(ctx, flat_obs, half_obs, flatSelfObsOffset, self_obs);
+    writeFlatObs(ctx, flat_obs, half_obs, flatPartnerObsOffset, partner_obs);
+    writeFlatObs(ctx, flat_obs, half_obs, flatRoomEntityObsOffset,
+                 room_ent_obs);
+    writeFlatObs(ctx, flat_obs, half_obs, flatDoorObsOffset, door_obs);
+    writeFlatObs(ctx, flat_obs, half_obs, flatStepsRemainingOffset,
+                 steps_remaining_obs);
+}
+
+// With lidar caching, starts each world's check for moved bodies. Runs once
+// per world. Paused worlds keep lidarCacheInvalid set until lidar next runs
+// for them.
+inline void lidarCacheSystem(Engine &ctx, WorldReset &)
+{
+    if (!shouldCollectObservations(ctx)) {
+        return;
+    }
+
+    ctx.data().lidarResetPoses = ctx.data().lidarCacheInvalid;
+    ctx.data().lidarSceneChanged = ctx.data().lidarCacheInvalid ? 1 : 0;
+    ctx.data().lidarCacheInvalid = false;
+}
+
+// With lidar caching, flags the world's lidar as stale if this body moved
+// since its LastPose. Every body that can be hit by lidar rays carries
+// LastPose, including the agents themselves, so an unflagged world means
+// every agent would see the same scene from the same pose. LastPose only
+// follows a body when it moves (or the level changed), so the samples drift
+// at most twice the epsilons, independently of how the bodies are scheduled.
+inline void lidarMovedBodiesSystem(Engine &ctx,
+                                   Position pos,
+                                   Rotation rot,
+                                   LastPose &last_pose)
+{
+    if (!shouldCollectObservations(ctx)) {
+        return;
+    }
+
+    Vector3 delta = pos - last_pose.position;
+    float rot_dot = rot.w * last_pose.rotation.w +
+        rot.x * last_pose.rotation.x +
+        rot.y * last_pose.rotation.y +
+        rot.z * last_pose.rotation.z;
+
+    bool moved = delta.length2() >
+            consts::lidarCachePosEpsilon * consts::lidarCachePosEpsilon ||
+        1.f - fabsf(rot_dot) > consts::lidarCacheRotEpsilon;
+
+    if (moved || ctx.data().lidarResetPoses) {
+        last_pose = LastPose {
+            .position = pos,
+            .rotation = rot,
+        };
+    }
+
+    // Other bodies in the world store concurrently
+    if (moved) {
+        AtomicI32Ref(ctx.data().lidarSceneChanged).store<sync::relaxed>(1);
+    }
 }
 
-// Launches consts::numLidarSamples per agent.
+// Launches Sim::numLidarSamples rays per agent. Samples past that count are
+// left at their zero initialized value.
 // This system is specially optimized in the GPU version:
 // a warp of threads is dispatched for each invocation of the system
 // and each thread in the warp traces one lidar ray for the agent.
 inline void lidarSystem(Engine &ctx,
                         Entity e,
-                        Lidar &lidar)
+                        Lidar &lidar,
+                        FlatObservation &flat_obs,
+                        HalfObservation &half_obs,
+                        CompactLidar &compact_lidar)
 {
+    if (!shouldCollectObservations(ctx)) {
+        return;
+    }
+
+    // Nothing moved: the samples from the last trace (and their copies in
+    // the flat, half and compact exports) are still current.
+    if (ctx.data().lidarCaching && ctx.data().lidarSceneChanged == 0) {
+        return;
+    }
+
     Vector3 pos = ctx.get<Position>(e);
     Quat rot = ctx.get<Rotation>(e);
     auto &bvh = ctx.singleton<broadphase::BVH>();
 
     Vector3 agent_fwd = rot.rotateVec(math::fwd);
     Vector3 right = rot.rotateVec(math::right);
+    Vector3 ray_origin = pos + 0.5f * math::up;
 
-    auto traceRay = [&](int32_t idx) {
-        float theta = 2.f * math::pi * (
-            float(idx) / float(consts::numLidarSamples)) + math::pi / 2.f;
-        float x = cosf(theta);
-        float y = sinf(theta);
+    const float *ray_x = ctx.data().lidarRayX;
+    const float *ray_y = ctx.data().lidarRayY;
 
-        Vector3 ray_dir = (x * right + y * agent_fwd).normalize();
+    auto rayDir = [&](int32_t idx) {
+        return (ray_x[idx] * right + ray_y[idx] * agent_fwd).normalize();
+    };
 
+    auto traceRay = [&](int32_t idx, Vector3 ray_dir) {
         float hit_t;
         Vector3 hit_normal;
         Entity hit_entity =
-            bvh.traceRay(pos + 0.5f * math::up, ray_dir, &hit_t,
-                         &hit_normal, 200.f);
+            bvh.traceRay(ray_origin, ray_dir, &hit_t, &hit_normal,
+                         ctx.data().lidarMaxRange);
 
+        float depth;
+        EntityType entity_type;
         if (hit_entity == Entity::none()) {
-            lidar.samples[idx] = {
-                .depth = 0.f,
-                .encodedType = encodeType(EntityType::None),
-            };
+            depth = 0.f;
+            entity_type = EntityType::None;
         } else {
-            EntityType entity_type = ctx.get<EntityType>(hit_entity);
+            depth = distObs(hit_t);
+            entity_type = ctx.get<EntityType>(hit_entity);
+        }
 
-            lidar.samples[idx] = {
-                .depth = distObs(hit_t),
-                .encodedType = encodeType(entity_type),
+        lidar.samples[idx] = {
+            .depth = depth,
+            .encodedType = encodeType(entity_type),
+        };
+
+        writeFlatObs(ctx, flat_obs, half_obs, flatLidarOffset + 2 * idx,
+                     lidar.samples[idx]);
+
+        if (ctx.data().compactLidar) {
+            compact_lidar.samples[idx] = {
+                .depth = quantizeDistObs(depth),
+                .type = (uint8_t)entity_type,
             };
         }
     };
@@ -474,12 +705,21 @@ inline void lidarSystem(Engine &ctx,
     // warp level programming
     int32_t idx = threadIdx.x % 32;
 
-    if (idx < consts::numLidarSamples) {
-        traceRay(idx);
+    if (idx < ctx.data().numLidarSamples) {
+        traceRay(idx, rayDir(idx));
     }
 #else
-    for (CountT i = 0; i < consts::numLidarSamples; i++) {
-        traceRay(i);
+    // Build the whole fan first, a short loop the compiler can vectorize,
+    // so the BVH traversals below run back to back.
+    const int32_t num_samples = ctx.data().numLidarSamples;
+
+    Vector3 ray_dirs[consts::numLidarSamples];
+    for (int32_t i = 0; i < num_samples; i++) {
+        ray_dirs[i] = rayDir(i);
+    }
+
+    for (int32_t i = 0; i < num_samples; i++) {
+        traceRay(i, ray_dirs[i]);
     }
 #endif
 }
@@ -487,11 +727,16 @@ inline void lidarSystem(Engine &ctx,
 // Computes reward for each agent and keeps track of the max distance achieved
 // so far through the challenge. Continuous reward is provided for any new
 // distance achieved.
-inline void rewardSystem(Engine &,
+inline void rewardSystem(Engine &ctx,
                          Position pos,
                          Progress &progress,
                          Reward &out_reward)
 {
+    if (!isWorldActive(ctx)) {
+        out_reward.v = 0.f;
+        return;
+    }
+
     // Just in case agents do something crazy, clamp total reward
     float reward_pos = fminf(pos.y, consts::worldLength * 2);
 
@@ -519,6 +764,10 @@ inline void bonusRewardSystem(Engine &ctx,
                               Progress &progress,
                               Reward &reward)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     bool partners_close = true;
     for (CountT i = 0; i < consts::numAgents - 1; i++) {
         Entity other = others.e[i];
@@ -537,10 +786,14 @@ inline void bonusRewardSystem(Engine &ctx,
 // Keep track of the number of steps remaining in the episode and
 // notify training that an episode has completed by
 // setting done = 1 on the final step of the episode
-inline void stepTrackerSystem(Engine &,
+inline void stepTrackerSystem(Engine &ctx,
                               StepsRemaining &steps_remaining,
                               Done &done)
 {
+    if (!isWorldActive(ctx)) {
+        return;
+    }
+
     int32_t num_remaining = --steps_remaining.t;
     if (num_remaining == consts::episodeLen - 1) {
         done.v = 0;
@@ -550,6 +803,246 @@ inline void stepTrackerSystem(Engine &,
 
 }
 
+// Captures this world's dynamic state into its WorldSnapshot.
+// WorldReset is only queried to run the system once per world.
+inline void snapshotSystem(Engine &ctx, WorldReset &)
+{
+    WorldSnapshot &snapshot = *ctx.data().snapshot;
+    const LevelState &level = ctx.singleton<LevelState>();
+
+    snapshot.curWorldEpisode = ctx.data().curWorldEpisode;
+    snapshot.levelWorldIdx = ctx.data().levelWorldIdx;
+    snapshot.rng = ctx.data().rng;
+
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        Entity agent = ctx.data().agents[i];
+        AgentSnapshot &agent_snapshot = snapshot.agents[i];
+
+        agent_snapshot.position = ctx.get<Position>(agent);
+        agent_snapshot.rotation = ctx.get<Rotation>(agent);
+        agent_snapshot.velocity = ctx.get<Velocity>(agent);
+        agent_snapshot.progress = ctx.get<Progress>(agent);
+        agent_snapshot.stepsRemaining = ctx.get<StepsRemaining>(agent);
+        agent_snapshot.done = ctx.get<Done>(agent);
+        agent_snapshot.reward = ctx.get<Reward>(agent);
+
+        const GrabState &grab = ctx.get<GrabState>(agent);
+        agent_snapshot.grabRoom = -1;
+        agent_snapshot.grabSlot = -1;
+        agent_snapshot.grabAttachRot = grab.attachRot;
+        agent_snapshot.grabAttachPos = grab.attachPos;
+        agent_snapshot.grabSeparation = grab.separation;
+
+        if (grab.constraintEntity == Entity::none()) {
+            continue;
+        }
+
+        for (CountT j = 0; j < consts::numRooms; j++) {
+            for (CountT k = 0; k < consts::maxEntitiesPerRoom; k++) {
+                if (level.rooms[j].entities[k] == grab.grabbedEntity) {
+                    agent_snapshot.grabRoom = (int32_t)j;
+                    agent_snapshot.grabSlot = (int32_t)k;
+                }
+            }
+        }
+    }
+
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        const Room &room = level.rooms[i];
+
+        for (CountT j = 0; j < consts::maxEntitiesPerRoom; j++) {
+            Entity e = room.entities[j];
+            RoomEntitySnapshot &entity_snapshot = snapshot.roomEntities[i][j];
+
+            if (e == Entity::none()) {
+                continue;
+            }
+
+            entity_snapshot.position = ctx.get<Position>(e);
+            entity_snapshot.rotation = ctx.get<Rotation>(e);
+
+            if (ctx.get<EntityType>(e) == EntityType::Button) {
+                entity_snapshot.velocity = {
+                    Vector3::zero(),
+                    Vector3::zero(),
+                };
+                entity_snapshot.isPressed = ctx.get<ButtonState>(e).isPressed;
+            } else {
+                entity_snapshot.velocity = ctx.get<Velocity>(e);
+                entity_snapshot.isPressed = false;
+            }
+        }
+
+        snapshot.doors[i].position = ctx.get<Position>(room.door);
+        snapshot.doors[i].isOpen = ctx.get<OpenState>(room.door).isOpen;
+    }
+}
+
+// Rewinds the world to its WorldSnapshot if the Manager requested it. When
+// the snapshot holds a different level (another episode, or another world's
+// level for Manager::cloneWorld), the level is regenerated from the
+// snapshot's episode first, which recreates the same entities in the same
+// LevelState slots. Entity references are remapped through those slots.
+inline void restoreSystem(Engine &ctx, WorldReset &)
+{
+    if (*ctx.data().restoreSnapshot == 0) {
+        return;
+    }
+
+    const WorldSnapshot &snapshot = *ctx.data().snapshot;
+
+    ctx.data().lidarCacheInvalid = true;
+    ctx.data().refreshObservations = true;
+
+    if (snapshot.curWorldEpisode != ctx.data().curWorldEpisode ||
+            snapshot.levelWorldIdx != ctx.data().levelWorldIdx) {
+        cleanupWorld(ctx);
+        generateEpisode(ctx, snapshot.curWorldEpisode - 1,
+                        snapshot.levelWorldIdx);
+    } else {
+        for (CountT i = 0; i < consts::numAgents; i++) {
+            GrabState &grab = ctx.get<GrabState>(ctx.data().agents[i]);
+            if (grab.constraintEntity != Entity::none()) {
+                ctx.destroyEntity(grab.constraintEntity);
+                grab.constraintEntity = Entity::none();
+            }
+        }
+    }
+
+    ctx.data().rng = snapshot.rng;
+
+    const LevelState &level = ctx.singleton<LevelState>();
+
+    for (CountT i = 0; i < consts::numRooms; i++) {
+        const Room &room = level.rooms[i];
+
+        for (CountT j = 0; j < consts::maxEntitiesPerRoom; j++) {
+            Entity e = room.entities[j];
+            const RoomEntitySnapshot &entity_snapshot =
+                snapshot.roomEntities[i][j];
+
+            if (e == Entity::none()) {
+                continue;
+            }
+
+            ctx.get<Position>(e) = entity_snapshot.position;
+            ctx.get<Rotation>(e) = entity_snapshot.rotation;
+
+            if (ctx.get<EntityType>(e) == EntityType::Button) {
+                ctx.get<ButtonState>(e).isPressed = entity_snapshot.isPressed;
+            } else {
+                ctx.get<Velocity>(e) = entity_snapshot.velocity;
+            }
+        }
+
+        ctx.get<Position>(room.door) = snapshot.doors[i].position;
+        ctx.get<OpenState>(room.door).isOpen = snapshot.doors[i].isOpen;
+    }
+
+    for (CountT i = 0; i < consts::numAgents; i++) {
+        Entity agent = ctx.data().agents[i];
+        const AgentSnapshot &agent_snapshot = snapshot.agents[i];
+
+        ctx.get<Position>(agent) = agent_snapshot.position;
+        ctx.get<Rotation>(agent) = agent_snapshot.rotation;
+        ctx.get<Velocity>(agent) = agent_snapshot.velocity;
+        ctx.get<Progress>(agent) = agent_snapshot.progress;
+        ctx.get<StepsRemaining>(agent) = agent_snapshot.stepsRemaining;
+        ctx.get<Done>(agent) = agent_snapshot.done;
+        ctx.get<Reward>(agent) = agent_snapshot.reward;
+
+        if (agent_snapshot.grabRoom == -1) {
+            continue;
+        }
+
+        // Same joint grabSystem created, with the recorded parameters
+        Entity grabbed = level.rooms[agent_snapshot.grabRoom]
+            .entities[agent_snapshot.grabSlot];
+
+        GrabState &grab = ctx.get<GrabState>(agent);
+        grab.constraintEntity = PhysicsSystem::makeFixedJoint(ctx,
+            agent, grabbed,
+            Quat { 1, 0, 0, 0 }, agent_snapshot.grabAttachRot,
+            1.25f * math::fwd + 0.5f * math::up,
+            agent_snapshot.grabAttachPos,
+            agent_snapshot.grabSeparation);
+        grab.grabbedEntity = grabbed;
+        grab.attachRot = agent_snapshot.grabAttachRot;
+        grab.attachPos = agent_snapshot.grabAttachPos;
+        grab.separation = agent_snapshot.grabSeparation;
+    }
+}
+
+#ifndef MADRONA_GPU_MODE
+static inline uint64_t profileTimestampNS()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs first in an instrumented step graph to mark when this world's step
+// began. WorldReset is only queried to run the system once per world.
+inline void profileBeginSystem(Engine &ctx, WorldReset &)
+{
+    ctx.data().profile->lastTimestampNS = profileTimestampNS();
+}
+
+static inline uint32_t profileThreadID()
+{
+    static std::atomic<uint32_t> next_thread_id { 1 };
+    thread_local uint32_t thread_id =
+        next_thread_id.fetch_add(1, std::memory_order_relaxed);
+
+    return thread_id;
+}
+
+// Charges the time since the previous marker to the given section
+template <ProfileNode node>
+inline void profileMarkerSystem(Engine &ctx, WorldReset &)
+{
+    WorldProfile &profile = *ctx.data().profile;
+
+    uint64_t now = profileTimestampNS();
+    profile.totalNS[(size_t)node] += now - profile.lastTimestampNS;
+    profile.invocations[(size_t)node] += 1;
+
+    if (profile.traceEvents != nullptr &&
+            profile.numTraceEvents < (uint32_t)ProfileNode::NumNodes) {
+        profile.traceEvents[profile.numTraceEvents++] = ProfileEvent {
+            .startNS = profile.lastTimestampNS,
+            .endNS = now,
+            .node = node,
+            .threadID = profileThreadID(),
+        };
+    }
+
+    profile.lastTimestampNS = now;
+}
+#endif
+
+// When profiling, queues a marker after node that times the section ending
+// with it. Returns the node later sections should depend on, so that the
+// instrumented graph runs its sections one after another.
+template <ProfileNode section>
+static TaskGraphNodeID profileMarker(TaskGraphBuilder &builder,
+                                     bool profile,
+                                     TaskGraphNodeID node)
+{
+#ifndef MADRONA_GPU_MODE
+    if (profile) {
+        return builder.addToGraph<ParallelForNode<Engine,
+            profileMarkerSystem<section>,
+                WorldReset
+            >>({node});
+    }
+#else
+    (void)builder;
+    (void)profile;
+#endif
+
+    return node;
+}
+
 // Helper function for sorting nodes in the taskgraph.
 // Sorting is only supported / required on the GPU backend,
 // since the CPU backend currently keeps separate tables for each world.
@@ -570,10 +1063,116 @@ TaskGraph::NodeID queueSortByWorld(TaskGraph::Builder &builder,
 }
 #endif
 
-// Build the task graph
-void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
+// Collects the observations used by the policy for the next step and, on the
+// GPU backend, sorts the archetype tables. Shared between the Step and Init
+// task graphs. The lidar raycasts require an up to date BVH in deps.
+// Returns the last node queued.
+static TaskGraphNodeID setupObservationTasks(TaskGraphBuilder &builder,
+                                             const Sim::Config &cfg,
+                                             Span<const TaskGraphNodeID> deps,
+                                             bool profile)
 {
-    TaskGraphBuilder &builder = taskgraph_mgr.init(TaskGraphID::Step);
+    auto collect_obs = builder.addToGraph<ParallelForNode<Engine,
+        collectObservationsSystem,
+            Position,
+            Rotation,
+            Progress,
+            GrabState,
+            OtherAgents,
+            StepsRemaining,
+            SelfObservation,
+            PartnerObservations,
+            RoomEntityObservations,
+            DoorObservation,
+            FlatObservation,
+            HalfObservation
+        >>(deps);
+
+    collect_obs = profileMarker<ProfileNode::CollectObservations>(
+        builder, profile, collect_obs);
+
+    // The lidar system normally only depends on deps. When profiling it is
+    // ordered after the collect observations marker instead.
+    Span<const TaskGraphNodeID> lidar_deps = deps;
+    if (profile) {
+        lidar_deps = Span<const TaskGraphNodeID>(&collect_obs, 1);
+    }
+
+    // Lidar caching first decides, per world, whether anything moved
+    TaskGraphNodeID moved_bodies;
+    if (cfg.lidarCaching) {
+        auto lidar_cache = builder.addToGraph<ParallelForNode<Engine,
+            lidarCacheSystem,
+                WorldReset
+            >>(lidar_deps);
+
+        moved_bodies = builder.addToGraph<ParallelForNode<Engine,
+            lidarMovedBodiesSystem,
+                Position,
+                Rotation,
+                LastPose
+            >>({lidar_cache});
+
+        lidar_deps = Span<const TaskGraphNodeID>(&moved_bodies, 1);
+    }
+
+#ifdef MADRONA_GPU_MODE
+    // Note the use of CustomParallelForNode to create a taskgraph node
+    // that launches a warp of threads (32) for each invocation (1).
+    // The 32, 1 parameters could be changed to 32, 32 to create a system
+    // that cooperatively processes 32 entities within a warp.
+    auto lidar = builder.addToGraph<CustomParallelForNode<Engine,
+        lidarSystem, 32, 1,
+#else
+    auto lidar = builder.addToGraph<ParallelForNode<Engine,
+        lidarSystem,
+#endif
+            Entity,
+            Lidar,
+            FlatObservation,
+            HalfObservation,
+            CompactLidar
+        >>(lidar_deps);
+
+    lidar = profileMarker<ProfileNode::Lidar>(builder, profile, lidar);
+
+#ifdef MADRONA_GPU_MODE
+    // Sort entities, this could be conditional on reset like the second
+    // BVH build in the Step task graph.
+    auto sort_agents = queueSortByWorld<Agent>(
+        builder, {lidar, collect_obs});
+    auto sort_phys_objects = queueSortByWorld<PhysicsEntity>(
+        builder, {sort_agents});
+    auto sort_buttons = queueSortByWorld<ButtonEntity>(
+        builder, {sort_phys_objects});
+    auto sort_walls = queueSortByWorld<DoorEntity>(
+        builder, {sort_buttons});
+    return sort_walls;
+#else
+    (void)collect_obs;
+    return lidar;
+#endif
+}
+
+// Build the task graph executed by Manager::step.
+static void setupStepTasks(TaskGraphBuilder &builder,
+                           const Sim::Config &cfg)
+{
+    bool profile = cfg.worldProfiles != nullptr;
+
+    // With profiling enabled, every section below is followed by a marker
+    // node and the first section waits on this begin marker.
+    Span<const TaskGraphNodeID> move_deps(nullptr, 0);
+#ifndef MADRONA_GPU_MODE
+    TaskGraphNodeID profile_begin;
+    if (profile) {
+        profile_begin = builder.addToGraph<ParallelForNode<Engine,
+            profileBeginSystem,
+                WorldReset
+            >>({});
+        move_deps = Span<const TaskGraphNodeID>(&profile_begin, 1);
+    }
+#endif
 
     // Turn policy actions into movement
     auto move_sys = builder.addToGraph<ParallelForNode<Engine,
@@ -582,7 +1181,10 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             Rotation,
             ExternalForce,
             ExternalTorque
-        >>({});
+        >>(move_deps);
+
+    move_sys = profileMarker<ProfileNode::Movement>(
+        builder, profile, move_sys);
 
     // Scripted door behavior
     auto set_door_pos_sys = builder.addToGraph<ParallelForNode<Engine,
@@ -591,10 +1193,16 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             OpenState
         >>({move_sys});
 
+    set_door_pos_sys = profileMarker<ProfileNode::SetDoorPosition>(
+        builder, profile, set_door_pos_sys);
+
     // Build BVH for broadphase / raycasting
     auto broadphase_setup_sys = phys::PhysicsSystem::setupBroadphaseTasks(
         builder, {set_door_pos_sys});
 
+    broadphase_setup_sys = profileMarker<ProfileNode::Broadphase>(
+        builder, profile, broadphase_setup_sys);
+
     // Grab action, post BVH build to allow raycasting
     auto grab_sys = builder.addToGraph<ParallelForNode<Engine,
         grabSystem,
@@ -605,9 +1213,17 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             GrabState
         >>({broadphase_setup_sys});
 
+    grab_sys = profileMarker<ProfileNode::Grab>(builder, profile, grab_sys);
+
+    auto paused_vel_sys = builder.addToGraph<ParallelForNode<Engine,
+        pausedWorldVelocitySystem, Velocity>>({grab_sys});
+
     // Physics collision detection and solver
     auto substep_sys = phys::PhysicsSystem::setupPhysicsStepTasks(builder,
-        {grab_sys}, consts::numPhysicsSubsteps);
+        {paused_vel_sys}, consts::numPhysicsSubsteps);
+
+    substep_sys = profileMarker<ProfileNode::PhysicsStep>(
+        builder, profile, substep_sys);
 
     // Improve controllability of agents by setting their velocity to 0
     // after physics is done.
@@ -615,9 +1231,18 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
         agentZeroVelSystem, Velocity, Action>>(
             {substep_sys});
 
+    agent_zero_vel = profileMarker<ProfileNode::AgentZeroVelocity>(
+        builder, profile, agent_zero_vel);
+
+    auto paused_post_vel_sys = builder.addToGraph<ParallelForNode<Engine,
+        pausedWorldVelocitySystem, Velocity>>({agent_zero_vel});
+
     // Finalize physics subsystem work
     auto phys_done = phys::PhysicsSystem::setupCleanupTasks(
-        builder, {agent_zero_vel});
+        builder, {paused_post_vel_sys});
+
+    phys_done = profileMarker<ProfileNode::PhysicsCleanup>(
+        builder, profile, phys_done);
 
     // Check buttons
     auto button_sys = builder.addToGraph<ParallelForNode<Engine,
@@ -626,6 +1251,9 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             ButtonState
         >>({phys_done});
 
+    button_sys = profileMarker<ProfileNode::Button>(
+        builder, profile, button_sys);
+
     // Set door to start opening if button conditions are met
     auto door_open_sys = builder.addToGraph<ParallelForNode<Engine,
         doorOpenSystem,
@@ -633,6 +1261,9 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             DoorProperties
         >>({button_sys});
 
+    door_open_sys = profileMarker<ProfileNode::DoorOpen>(
+        builder, profile, door_open_sys);
+
     // Compute initial reward now that physics has updated the world state
     auto reward_sys = builder.addToGraph<ParallelForNode<Engine,
          rewardSystem,
@@ -641,6 +1272,9 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             Reward
         >>({door_open_sys});
 
+    reward_sys = profileMarker<ProfileNode::Reward>(
+        builder, profile, reward_sys);
+
     // Assign partner's reward
     auto bonus_reward_sys = builder.addToGraph<ParallelForNode<Engine,
          bonusRewardSystem,
@@ -649,6 +1283,9 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             Reward
         >>({reward_sys});
 
+    bonus_reward_sys = profileMarker<ProfileNode::BonusReward>(
+        builder, profile, bonus_reward_sys);
+
     // Check if the episode is over
     auto done_sys = builder.addToGraph<ParallelForNode<Engine,
         stepTrackerSystem,
@@ -656,12 +1293,18 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
             Done
         >>({bonus_reward_sys});
 
+    done_sys = profileMarker<ProfileNode::StepTracker>(
+        builder, profile, done_sys);
+
     // Conditionally reset the world if the episode is over
     auto reset_sys = builder.addToGraph<ParallelForNode<Engine,
         resetSystem,
             WorldReset
         >>({done_sys});
 
+    reset_sys = profileMarker<ProfileNode::Reset>(
+        builder, profile, reset_sys);
+
     auto clear_tmp = builder.addToGraph<ResetTmpAllocNode>({reset_sys});
     (void)clear_tmp;
 
@@ -673,61 +1316,98 @@ void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
 #endif
 
     // This second BVH build is a limitation of the current taskgraph API.
-    // It's only necessary if the world was reset, but we don't have a way
-    // to conditionally queue taskgraph nodes yet.
+    // Besides picking up reset worlds, it moves the BVH leaves to where the
+    // physics step left the bodies, which the lidar raycasts rely on.
     auto post_reset_broadphase = phys::PhysicsSystem::setupBroadphaseTasks(
         builder, {reset_sys});
 
+    post_reset_broadphase = profileMarker<ProfileNode::PostResetBroadphase>(
+        builder, profile, post_reset_broadphase);
+
     // Finally, collect observations for the next step.
-    auto collect_obs = builder.addToGraph<ParallelForNode<Engine,
-        collectObservationsSystem,
-            Position,
-            Rotation,
-            Progress,
-            GrabState,
-            OtherAgents,
-            SelfObservation,
-            PartnerObservations,
-            RoomEntityObservations,
-            DoorObservation
-        >>({post_reset_broadphase});
+    auto obs_done = setupObservationTasks(
+        builder, cfg, {post_reset_broadphase}, profile);
 
-    // The lidar system
-#ifdef MADRONA_GPU_MODE
-    // Note the use of CustomParallelForNode to create a taskgraph node
-    // that launches a warp of threads (32) for each invocation (1).
-    // The 32, 1 parameters could be changed to 32, 32 to create a system
-    // that cooperatively processes 32 entities within a warp.
-    auto lidar = builder.addToGraph<CustomParallelForNode<Engine,
-        lidarSystem, 32, 1,
-#else
-    auto lidar = builder.addToGraph<ParallelForNode<Engine,
-        lidarSystem,
-#endif
-            Entity,
-            Lidar
-        >>({post_reset_broadphase});
+    if (cfg.renderBridge) {
+        auto render_sys = RenderingSystem::setupTasks(builder,
+            {profile ? obs_done : reset_sys});
+        profileMarker<ProfileNode::Render>(builder, profile, render_sys);
+    }
+}
+
+// Build the task graph executed once by the Manager after the worlds have
+// been generated in Sim::Sim. This only builds the BVH and collects
+// the initial observations, rather than running a full physics step.
+static void setupInitTasks(TaskGraphBuilder &builder, const Sim::Config &cfg)
+{
+    auto broadphase_setup_sys =
+        phys::PhysicsSystem::setupBroadphaseTasks(builder, {});
+
+    auto obs_done = setupObservationTasks(
+        builder, cfg, {broadphase_setup_sys}, false);
+
+    builder.addToGraph<ParallelForNode<Engine,
+        finishObservationRefreshSystem,
+            WorldReset
+        >>({obs_done});
 
     if (cfg.renderBridge) {
-        RenderingSystem::setupTasks(builder, {reset_sys});
+        RenderingSystem::setupTasks(builder, {});
     }
+}
+
+// Build the task graph run by Manager::snapshot
+static void setupSnapshotTasks(TaskGraphBuilder &builder)
+{
+    builder.addToGraph<ParallelForNode<Engine,
+        snapshotSystem,
+            WorldReset
+        >>({});
+}
+
+// Build the task graph run by Manager::restore. Like the Init graph, this
+// rebuilds the BVH and collects observations for the restored state without
+// taking a physics step.
+static void setupRestoreTasks(TaskGraphBuilder &builder,
+                              const Sim::Config &cfg)
+{
+    auto restore_sys = builder.addToGraph<ParallelForNode<Engine,
+        restoreSystem,
+            WorldReset
+        >>({});
+
+    auto clear_tmp = builder.addToGraph<ResetTmpAllocNode>({restore_sys});
+    (void)clear_tmp;
 
 #ifdef MADRONA_GPU_MODE
-    // Sort entities, this could be conditional on reset like the second
-    // BVH build above.
-    auto sort_agents = queueSortByWorld<Agent>(
-        builder, {lidar, collect_obs});
-    auto sort_phys_objects = queueSortByWorld<PhysicsEntity>(
-        builder, {sort_agents});
-    auto sort_buttons = queueSortByWorld<ButtonEntity>(
-        builder, {sort_phys_objects});
-    auto sort_walls = queueSortByWorld<DoorEntity>(
-        builder, {sort_buttons});
-    (void)sort_walls;
-#else
-    (void)lidar;
-    (void)collect_obs;
+    // Restoring into a different episode destroys the old level entities,
+    // and restoring a grab replaces its joint entity.
+    auto recycle_sys = builder.addToGraph<RecycleEntitiesNode>({restore_sys});
+    (void)recycle_sys;
 #endif
+
+    auto broadphase_setup_sys = phys::PhysicsSystem::setupBroadphaseTasks(
+        builder, {restore_sys});
+
+    auto obs_done = setupObservationTasks(
+        builder, cfg, {broadphase_setup_sys}, false);
+
+    builder.addToGraph<ParallelForNode<Engine,
+        finishObservationRefreshSystem,
+            WorldReset
+        >>({obs_done});
+
+    if (cfg.renderBridge) {
+        RenderingSystem::setupTasks(builder, {restore_sys});
+    }
+}
+
+void Sim::setupTasks(TaskGraphManager &taskgraph_mgr, const Config &cfg)
+{
+    setupStepTasks(taskgraph_mgr.init(TaskGraphID::Step), cfg);
+    setupInitTasks(taskgraph_mgr.init(TaskGraphID::Init), cfg);
+    setupSnapshotTasks(taskgraph_mgr.init(TaskGraphID::Snapshot));
+    setupRestoreTasks(taskgraph_mgr.init(TaskGraphID::Restore), cfg);
 }
 
 Sim::Sim(Engine &ctx,
@@ -735,21 +1415,52 @@ Sim::Sim(Engine &ctx,
          const WorldInit &)
     : WorldBase(ctx)
 {
-    // Currently the physics system needs an upper bound on the number of
-    // entities that will be stored in the BVH. We plan to fix this in
-    // a future release.
-    constexpr CountT max_total_entities = consts::numAgents +
-        consts::numRooms * (consts::maxEntitiesPerRoom + 3) +
-        4; // side walls + floor
-
     phys::PhysicsSystem::init(ctx, cfg.rigidBodyObjMgr,
         consts::deltaT, consts::numPhysicsSubsteps, -9.8f * math::up,
-        max_total_entities);
+        consts::maxTotalEntities);
 
     initRandKey = cfg.initRandKey;
     autoReset = cfg.autoReset;
 
     enableRender = cfg.renderBridge != nullptr;
+    flatObservations = cfg.flatObservations;
+    obsPrecision = cfg.obsPrecision;
+    compactLidar = cfg.compactLidar;
+
+    numLidarSamples = cfg.numLidarSamples;
+    lidarMaxRange = cfg.lidarMaxRange;
+    lidarCaching = cfg.lidarCaching;
+    lidarCacheInvalid = true;
+    lidarResetPoses = true;
+    lidarSceneChanged = 1;
+
+    // Consumed by the Init graph
+    refreshObservations = true;
+
+    // A full circle spaces the rays evenly starting straight ahead. Narrower
+    // fans include both edges.
+    bool full_circle = cfg.lidarSpan >= 2.f * math::pi - 1e-4f;
+    for (CountT i = 0; i < consts::numLidarSamples; i++) {
+        float theta;
+        if (full_circle) {
+            theta = 2.f * math::pi * (
+                float(i) / float(numLidarSamples)) + math::pi / 2.f;
+        } else if (numLidarSamples > 1) {
+            theta = math::pi / 2.f + cfg.lidarSpan * (
+                float(i) / float(numLidarSamples - 1) - 0.5f);
+        } else {
+            theta = math::pi / 2.f;
+        }
+
+        lidarRayX[i] = cosf(theta);
+        lidarRayY[i] = sinf(theta);
+    }
+
+    profile = cfg.worldProfiles != nullptr ?
+        &cfg.worldProfiles[ctx.worldID().idx] : nullptr;
+
+    snapshot = &cfg.worldSnapshots[ctx.worldID().idx];
+    restoreSnapshot = &cfg.snapshotRestoreMask[ctx.worldID().idx];
 
     if (enableRender) {
         RenderingSystem::init(ctx, cfg.renderBridge);
@@ -757,6 +1468,9 @@ Sim::Sim(Engine &ctx,
 
     curWorldEpisode = 0;
 
+    // All worlds start out active, Manager may pause them later
+    ctx.singleton<WorldActive>().active = 1;
+
     // Creates agents, walls, etc.
     createPersistentEntities(ctx);
 
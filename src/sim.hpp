@@ -15,6 +15,9 @@ class Engine;
 // that can be separately executed
 enum class TaskGraphID : uint32_t {
   Step,
+  Init,
+  Snapshot,
+  Restore,
   NumTaskGraphs,
 };
 
@@ -22,6 +25,7 @@ enum class TaskGraphID : uint32_t {
 // for each component exported to the training code.
 enum class ExportID : uint32_t {
     Reset,
+    Active,
     Action,
     Reward,
     Done,
@@ -31,9 +35,106 @@ enum class ExportID : uint32_t {
     DoorObservation,
     Lidar,
     StepsRemaining,
+    FlatObservation,
+    HalfObservation,
+    CompactLidar,
     NumExports,
 };
 
+// Sections of the step task graphs timed when profiling is enabled. Each one
+// covers the task graph node(s) added for it in Sim::setupTasks.
+enum class ProfileNode : uint32_t {
+    Movement,
+    SetDoorPosition,
+    Broadphase,
+    Grab,
+    PhysicsStep,
+    AgentZeroVelocity,
+    PhysicsCleanup,
+    Button,
+    DoorOpen,
+    Reward,
+    BonusReward,
+    StepTracker,
+    Reset,
+    PostResetBroadphase,
+    CollectObservations,
+    Lidar,
+    Render,
+    NumNodes,
+};
+
+// A single timed section, recorded for trace output
+struct ProfileEvent {
+    uint64_t startNS;
+    uint64_t endNS;
+    ProfileNode node;
+    // Small per-process ID of the worker thread that ran the section
+    uint32_t threadID;
+};
+
+// Per-world timings accumulated by the profiling marker nodes (CPU backend
+// only). A world's task graph always runs on a single worker thread, so the
+// markers update these without synchronization.
+struct WorldProfile {
+    uint64_t lastTimestampNS;
+    uint64_t totalNS[(size_t)ProfileNode::NumNodes];
+    uint64_t invocations[(size_t)ProfileNode::NumNodes];
+
+    // When non-null, markers also append one event per section here. Holds
+    // ProfileNode::NumNodes events, the Manager drains it after each step.
+    ProfileEvent *traceEvents;
+    uint32_t numTraceEvents;
+};
+
+// Dynamic state of a single agent, see WorldSnapshot
+struct AgentSnapshot {
+    Position position;
+    Rotation rotation;
+    Velocity velocity;
+    Progress progress;
+    StepsRemaining stepsRemaining;
+    Done done;
+    Reward reward;
+
+    // Grabbed entity as an index into LevelState, grabRoom is -1 when the
+    // agent isn't grabbing anything. The remaining fields are the joint
+    // parameters recorded in GrabState.
+    int32_t grabRoom;
+    int32_t grabSlot;
+    madrona::math::Quat grabAttachRot;
+    madrona::math::Vector3 grabAttachPos;
+    float grabSeparation;
+};
+
+// Dynamic state of an entity in LevelState. Buttons only use isPressed,
+// all other room entities leave it false.
+struct RoomEntitySnapshot {
+    Position position;
+    Rotation rotation;
+    Velocity velocity;
+    bool isPressed;
+};
+
+struct DoorSnapshot {
+    Position position;
+    bool isOpen;
+};
+
+// Everything needed to rewind a world, written by the TaskGraphID::Snapshot
+// graph. Static level geometry isn't stored: the level is a deterministic
+// function of curWorldEpisode and levelWorldIdx, so restoring into a
+// different level regenerates it before the dynamic state is written back.
+struct WorldSnapshot {
+    uint32_t curWorldEpisode;
+    uint32_t levelWorldIdx;
+    madrona::RNG rng;
+    AgentSnapshot agents[consts::numAgents];
+    RoomEntitySnapshot roomEntities[consts::numRooms]
+                                   [consts::maxEntitiesPerRoom];
+    DoorSnapshot doors[consts::numRooms];
+};
+
 // Stores values for the ObjectID component that links entities to
 // render / physics assets.
 enum class SimObject : uint32_t {
@@ -59,6 +160,29 @@ struct Sim : public madrona::WorldBase {
         RandKey initRandKey;
         madrona::phys::ObjectManager *rigidBodyObjMgr;
         const madrona::render::RenderECSBridge *renderBridge;
+        // One entry per world. When non-null, the step task graphs are
+        // instrumented with timing marker nodes (CPU backend only).
+        WorldProfile *worldProfiles;
+        // Manager owned, one entry each per world. The Snapshot graph writes
+        // worldSnapshots, the Restore graph rewinds every world with a
+        // non-zero snapshotRestoreMask entry to its snapshot.
+        WorldSnapshot *worldSnapshots;
+        const int32_t *snapshotRestoreMask;
+        // Also write every agent's observations into FlatObservation
+        bool flatObservations;
+        // When not Float32, also write them into HalfObservation
+        ObservationPrecision obsPrecision;
+        // Also write the lidar samples into CompactLidar
+        bool compactLidar;
+        // Rays traced per agent (at most consts::numLidarSamples), spread
+        // over lidarSpan radians centered on the agent's forward direction,
+        // and how far they reach. A span of 2 pi is a full circle.
+        int32_t numLidarSamples;
+        float lidarSpan;
+        float lidarMaxRange;
+        // Skip tracing lidar in steps where no body moved, keeping the
+        // previous samples
+        bool lidarCaching;
     };
 
     // This class would allow per-world custom data to be passed into
@@ -71,8 +195,11 @@ struct Sim : public madrona::WorldBase {
                               const Config &cfg);
 
     // Sim::setupTasks is called during initialization to build
-    // the system task graph that will be invoked by the 
-    // Manager class (src/mgr.hpp) for each step.
+    // the system task graphs that will be invoked by the 
+    // Manager class (src/mgr.hpp): TaskGraphID::Step for each step and
+    // TaskGraphID::Init once to populate the initial observations.
+    // TaskGraphID::Snapshot and TaskGraphID::Restore implement
+    // Manager::snapshot and Manager::restore.
     static void setupTasks(madrona::TaskGraphManager &mgr,
                            const Config &cfg);
 
@@ -93,8 +220,50 @@ struct Sim : public madrona::WorldBase {
     // Are we enabling rendering? (whether with the viewer or not)
     bool enableRender;
 
+    // Copies of Config::flatObservations, Config::obsPrecision and
+    // Config::compactLidar
+    bool flatObservations;
+    ObservationPrecision obsPrecision;
+    bool compactLidar;
+
+    // Copies of Config::numLidarSamples, Config::lidarMaxRange and
+    // Config::lidarCaching
+    int32_t numLidarSamples;
+    float lidarMaxRange;
+    bool lidarCaching;
+
+    // With lidarCaching: lidarCacheInvalid is set when the level is
+    // regenerated or restored, and lidarResetPoses carries it into
+    // lidarMovedBodiesSystem for the step that consumes it.
+    // lidarSceneChanged is recomputed before lidarSystem each step and is 0
+    // when the previous samples can be reused. Bodies set it concurrently,
+    // so it is only written with atomic stores while they run.
+    bool lidarCacheInvalid;
+    bool lidarResetPoses;
+    int32_t lidarSceneChanged;
+
+    // Set when the world's state is created or restored, so the Init and
+    // Restore graphs collect observations even if the world is paused
+    bool refreshObservations;
+
+    // Lidar ray directions in the agent's (right, forward) frame, computed
+    // once here so lidarSystem doesn't evaluate cosf / sinf for every ray
+    float lidarRayX[consts::numLidarSamples];
+    float lidarRayY[consts::numLidarSamples];
+
+    // This world's entry in Config::worldProfiles, or nullptr
+    WorldProfile *profile;
+
+    // This world's entries in Config::worldSnapshots and
+    // Config::snapshotRestoreMask
+    WorldSnapshot *snapshot;
+    const int32_t *restoreSnapshot;
+
     // Current episode within this world
     uint32_t curWorldEpisode;
+    // World whose episode sequence the current level was generated from.
+    // This is the world's own index unless it was cloned from another one.
+    uint32_t levelWorldIdx;
     // Random number generator state
     madrona::RNG rng;
 
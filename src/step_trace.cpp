@@ -0,0 +1,90 @@
+#include "step_trace.hpp"
+
+#include <madrona/crash.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace madEscape {
+
+StepTraceWriter::StepTraceWriter(const char *path)
+    : file_(fopen(path, "w")),
+      baseNS_(timestampNS()),
+      firstEvent_(true),
+      namedThreads_()
+{
+    if (file_ == nullptr) {
+        FATAL("Failed to open trace file %s: %s", path, strerror(errno));
+    }
+
+    // The JSON array format tolerates a missing closing bracket, so the
+    // trace stays loadable if the process exits without destroying the
+    // Manager.
+    fputs("[\n", file_);
+}
+
+StepTraceWriter::~StepTraceWriter()
+{
+    fputs("\n]\n", file_);
+    fclose(file_);
+}
+
+uint64_t StepTraceWriter::timestampNS()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StepTraceWriter::addSpan(const char *name,
+                              const char *category,
+                              uint32_t thread_id,
+                              uint64_t start_ns,
+                              uint64_t end_ns,
+                              int64_t world_idx)
+{
+    nameThread(thread_id);
+
+    double ts_us = start_ns > baseNS_ ?
+        (double)(start_ns - baseNS_) / 1e3 : 0.0;
+    double dur_us = end_ns > start_ns ?
+        (double)(end_ns - start_ns) / 1e3 : 0.0;
+
+    fprintf(file_, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+            firstEvent_ ? "" : ",\n", name, category, ts_us, dur_us,
+            thread_id);
+    firstEvent_ = false;
+
+    if (world_idx >= 0) {
+        fprintf(file_, ",\"args\":{\"world\":%lld}", (long long)world_idx);
+    }
+
+    fputs("}", file_);
+}
+
+void StepTraceWriter::nameThread(uint32_t thread_id)
+{
+    if (thread_id < namedThreads_.size() && namedThreads_[thread_id]) {
+        return;
+    }
+
+    if (thread_id >= namedThreads_.size()) {
+        namedThreads_.resize(thread_id + 1, false);
+    }
+    namedThreads_[thread_id] = true;
+
+    char thread_name[32];
+    if (thread_id == 0) {
+        snprintf(thread_name, sizeof(thread_name), "manager");
+    } else {
+        snprintf(thread_name, sizeof(thread_name), "worker %u", thread_id);
+    }
+
+    fprintf(file_, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            firstEvent_ ? "" : ",\n", thread_id, thread_name);
+    firstEvent_ = false;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace madEscape {
+
+// Streams Chrome trace event JSON (viewable in chrome://tracing or
+// ui.perfetto.dev) for Manager::Config::tracePath. Spans are complete ("X")
+// events on the steady_clock timeline, thread 0 is the thread driving the
+// Manager and other thread IDs are executor worker threads.
+class StepTraceWriter {
+public:
+    StepTraceWriter(const char *path);
+    ~StepTraceWriter();
+
+    StepTraceWriter(const StepTraceWriter &) = delete;
+    StepTraceWriter & operator=(const StepTraceWriter &) = delete;
+
+    // Nanoseconds on the same clock as the simulation's profile markers
+    static uint64_t timestampNS();
+
+    // world_idx < 0 omits the world argument
+    void addSpan(const char *name,
+                 const char *category,
+                 uint32_t thread_id,
+                 uint64_t start_ns,
+                 uint64_t end_ns,
+                 int64_t world_idx = -1);
+
+    // Records a span on thread 0 covering the lifetime of the scope. No-op
+    // when writer is null, so callers don't need to check.
+    class Scope {
+    public:
+        inline Scope(StepTraceWriter *writer, const char *name)
+            : writer_(writer),
+              name_(name),
+              start_(writer ? timestampNS() : 0)
+        {}
+
+        inline ~Scope()
+        {
+            if (writer_) {
+                writer_->addSpan(name_, "manager", 0, start_, timestampNS());
+            }
+        }
+
+    private:
+        StepTraceWriter *writer_;
+        const char *name_;
+        uint64_t start_;
+    };
+
+private:
+    void nameThread(uint32_t thread_id);
+
+    FILE *file_;
+    uint64_t baseNS_;
+    bool firstEvent_;
+    std::vector<bool> namedThreads_;
+};
+
+}
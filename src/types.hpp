@@ -7,6 +7,7 @@
 #include <madrona/render/ecs.hpp>
 
 #include "consts.hpp"
+#include "half.hpp"
 
 namespace madEscape {
 
@@ -32,6 +33,14 @@ struct WorldReset {
     int32_t reset;
 };
 
+// WorldActive is a per-world singleton component that allows code external to
+// the simulation to pause individual worlds. While active is 0, the game logic,
+// reward and observation systems skip the world entirely, its bodies are held
+// still and any pending reset is deferred until the world is reactivated.
+struct WorldActive {
+    int32_t active;
+};
+
 // Discrete action component. Ranges are defined by consts::numMoveBuckets (5),
 // repeated here for clarity
 struct Action {
@@ -123,12 +132,59 @@ struct Lidar {
     LidarSample samples[consts::numLidarSamples];
 };
 
+// Lidar quantized to a byte per value: depth (distObs, clamped to [0, 1])
+// scaled to [0, 255], and the raw EntityType. Only written by lidarSystem
+// when Sim::Config::compactLidar is set.
+struct CompactLidarSample {
+    uint8_t depth;
+    uint8_t type;
+};
+
+struct CompactLidar {
+    CompactLidarSample samples[consts::numLidarSamples];
+};
+
+// CompactLidar is exported as a [N, A, numLidarSamples, 2] uint8 tensor
+static_assert(sizeof(CompactLidar) == 2 * consts::numLidarSamples);
+
 // Number of steps remaining in the episode. Allows non-recurrent policies
 // to track the progression of time.
 struct StepsRemaining {
     uint32_t t;
 };
 
+// Offsets of each observation within FlatObservation::features, in floats.
+// Every block keeps the field order of its struct above.
+inline constexpr CountT flatSelfObsOffset = 0;
+inline constexpr CountT flatPartnerObsOffset =
+    flatSelfObsOffset + sizeof(SelfObservation) / sizeof(float);
+inline constexpr CountT flatRoomEntityObsOffset =
+    flatPartnerObsOffset + sizeof(PartnerObservations) / sizeof(float);
+inline constexpr CountT flatDoorObsOffset =
+    flatRoomEntityObsOffset + sizeof(RoomEntityObservations) / sizeof(float);
+inline constexpr CountT flatLidarOffset =
+    flatDoorObsOffset + sizeof(DoorObservation) / sizeof(float);
+// StepsRemaining::t / consts::episodeLen
+inline constexpr CountT flatStepsRemainingOffset =
+    flatLidarOffset + sizeof(Lidar) / sizeof(float);
+// Agent index / (consts::numAgents - 1), constant for each agent
+inline constexpr CountT flatAgentIDOffset = flatStepsRemainingOffset + 1;
+inline constexpr CountT numFlatObsFeatures = flatAgentIDOffset + 1;
+
+// All of an agent's observations in one array, the same features
+// scripts/policy.py builds out of the separate observation tensors. Only
+// written by the observation systems when Sim::Config::flatObservations is
+// set, exported as a [N * A, numFlatObsFeatures] tensor.
+struct FlatObservation {
+    float features[numFlatObsFeatures];
+};
+
+// FlatObservation converted to fp16 or bf16 (Sim::Config::obsPrecision),
+// written by the observation systems instead of a separate conversion pass.
+struct HalfObservation {
+    uint16_t features[numFlatObsFeatures];
+};
+
 // Tracks progress the agent has made through the challenge, used to add
 // reward when more progress has been made
 struct Progress {
@@ -144,6 +200,21 @@ struct OtherAgents {
 // Tracks if an agent is currently grabbing another entity
 struct GrabState {
     Entity constraintEntity;
+
+    // The entity and joint parameters of the current grab, kept so
+    // snapshots can recreate the joint
+    Entity grabbedEntity;
+    madrona::math::Quat attachRot;
+    madrona::math::Vector3 attachPos;
+    float separation;
+};
+
+// Pose of a body that lidar rays can hit when it last moved by more than
+// consts::lidarCachePosEpsilon / lidarCacheRotEpsilon. Only maintained with
+// Sim::Config::lidarCaching.
+struct LastPose {
+    madrona::math::Vector3 position;
+    madrona::math::Quat rotation;
 };
 
 // This enum is used to track the type of each entity for the purposes of
@@ -210,6 +281,7 @@ struct Agent : public madrona::Archetype<
     Progress,
     OtherAgents,
     EntityType,
+    LastPose,
 
     // Input
     Action,
@@ -220,7 +292,10 @@ struct Agent : public madrona::Archetype<
     RoomEntityObservations,
     DoorObservation,
     Lidar,
+    CompactLidar,
     StepsRemaining,
+    FlatObservation,
+    HalfObservation,
 
     // Reward, episode termination
     Reward,
@@ -240,6 +315,7 @@ struct DoorEntity : public madrona::Archetype<
     OpenState,
     DoorProperties,
     EntityType,
+    LastPose,
     madrona::render::Renderable
 > {};
 
@@ -260,6 +336,7 @@ struct ButtonEntity : public madrona::Archetype<
 struct PhysicsEntity : public madrona::Archetype<
     RigidBody,
     EntityType,
+    LastPose,
     madrona::render::Renderable
 > {};
 
@@ -1,31 +1,20 @@
 #include <madrona/viz/viewer.hpp>
 #include <madrona/render/render_mgr.hpp>
 #include <madrona/window.hpp>
+#include <madrona/crash.hpp>
 
 #include "sim.hpp"
 #include "mgr.hpp"
 #include "types.hpp"
+#include "action_trace.hpp"
 
 #include <filesystem>
 #include <fstream>
+#include <memory>
 
 using namespace madrona;
 using namespace madrona::viz;
 
-static HeapArray<int32_t> readReplayLog(const char *path)
-{
-    std::ifstream replay_log(path, std::ios::binary);
-    replay_log.seekg(0, std::ios::end);
-    int64_t size = replay_log.tellg();
-    replay_log.seekg(0, std::ios::beg);
-
-    HeapArray<int32_t> log(size / sizeof(int32_t));
-
-    replay_log.read((char *)log.data(), (size / sizeof(int32_t)) * sizeof(int32_t));
-
-    return log;
-}
-
 int main(int argc, char *argv[])
 {
     using namespace madEscape;
@@ -53,12 +42,24 @@ int main(int argc, char *argv[])
         replay_log_path = argv[3];
     }
 
-    auto replay_log = Optional<HeapArray<int32_t>>::none();
+    std::unique_ptr<ActionTraceReader> replay_log;
     uint32_t cur_replay_step = 0;
     uint32_t num_replay_steps = 0;
+    uint32_t rand_seed = 5;
+    bool auto_reset = false;
     if (replay_log_path != nullptr) {
-        replay_log = readReplayLog(replay_log_path);
-        num_replay_steps = replay_log->size() / (num_worlds * num_views * 4);
+        replay_log = std::make_unique<ActionTraceReader>(replay_log_path);
+
+        const ActionTraceHeader &replay_header = replay_log->header();
+        if (replay_header.numWorlds != num_worlds ||
+                replay_header.numAgents != num_views) {
+            FATAL("Replay log was recorded with %u worlds and %u agents",
+                  replay_header.numWorlds, replay_header.numAgents);
+        }
+
+        num_replay_steps = (uint32_t)replay_log->numSteps();
+        rand_seed = replay_header.randSeed;
+        auto_reset = (replay_header.flags & actionTraceAutoReset) != 0;
     }
 
     bool enable_batch_renderer =
@@ -77,8 +78,8 @@ int main(int argc, char *argv[])
         .execMode = exec_mode,
         .gpuID = 0,
         .numWorlds = num_worlds,
-        .randSeed = 5,
-        .autoReset = replay_log.has_value(),
+        .randSeed = rand_seed,
+        .autoReset = auto_reset,
         .enableBatchRenderer = enable_batch_renderer,
         .extRenderAPI = wm.gpuAPIManager().backend(),
         .extRenderDev = render_gpu.device(),
@@ -110,23 +111,20 @@ int main(int argc, char *argv[])
 
         printf("Step: %u\n", cur_replay_step);
 
+        Span<const Action> step_actions = replay_log->step(cur_replay_step);
+
         for (uint32_t i = 0; i < num_worlds; i++) {
             for (uint32_t j = 0; j < num_views; j++) {
-                uint32_t base_idx = 0;
-                base_idx = 4 * (cur_replay_step * num_views * num_worlds +
-                    i * num_views + j);
-
-                int32_t move_amount = (*replay_log)[base_idx];
-                int32_t move_angle = (*replay_log)[base_idx + 1];
-                int32_t turn = (*replay_log)[base_idx + 2];
-                int32_t g = (*replay_log)[base_idx + 3];
+                const Action &action = step_actions[i * num_views + j];
 
                 printf("%d, %d: %d %d %d %d\n",
-                       i, j, move_amount, move_angle, turn, g);
-                mgr.setAction(i, j, move_amount, move_angle, turn, g);
+                       i, j, action.moveAmount, action.moveAngle,
+                       action.rotate, action.grab);
             }
         }
 
+        mgr.setActions(step_actions);
+
         cur_replay_step++;
 
         return false;
@@ -245,7 +243,7 @@ int main(int argc, char *argv[])
 
         mgr.setAction(world_idx, agent_idx, move_amount, move_angle, r, g);
     }, [&]() {
-        if (replay_log.has_value()) {
+        if (replay_log != nullptr) {
             bool replay_finished = replayStep();
 
             if (replay_finished) {